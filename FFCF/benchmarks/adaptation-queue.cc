@@ -0,0 +1,119 @@
+// Query throughput of 1, 2, 4, ... threads up to the number of cores (or
+// the thread count given) on a CuckooFilterChangeFLength in concurrent
+// mode, where every query is a key that is not in the filter and every
+// hit is corrected:
+//
+//   inline: ChangeFingerprint() on the query thread
+//   queued: AdaptationQueue::Push(), applied by the queue's worker
+//
+// Every thread queries the same keys, so most false positives are seen
+// again by the other threads. The queued run also reports the counters of
+// the queue and how many of the false positives remain after Drain().
+//
+// Usage: adaptation-queue [log2 number of keys, default 20] [max threads]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "adaptationqueue.h"
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::AdaptationQueue;
+using cuckoofilter::CuckooFilterChangeFLength;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12> Filter;
+
+const size_t kQueriesPerThread = 1 << 22;
+
+// queue is NULL for the inline run
+void Run(const char *name, Filter &filter, AdaptationQueue<Filter> *queue,
+         const unsigned threads) {
+  std::vector<size_t> hits(threads * 8, 0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      size_t hit = 0;
+      for (uint64_t k = 1ULL << 40; k < (1ULL << 40) + kQueriesPerThread;
+           k++) {
+        if (filter.Contain(k) != cuckoofilter::Ok) {
+          continue;
+        }
+        hit++;
+        if (queue != NULL) {
+          queue->Push(k);
+        } else {
+          filter.ChangeFingerprint(k);
+        }
+      }
+      // one cache line apart
+      hits[t * 8] = hit;
+    }));
+  }
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t hit = 0;
+  for (unsigned t = 0; t < threads; t++) {
+    hit += hits[t * 8];
+  }
+  std::cout << std::setw(8) << name << std::setw(4) << threads
+            << " threads  " << std::fixed << std::setprecision(2)
+            << threads * kQueriesPerThread / elapsed.count() / 1e6
+            << " Mqueries/s  hits " << hit;
+  if (queue != NULL) {
+    std::cout << "  depth " << queue->Depth();
+    queue->Drain();
+    std::cout << "  dropped " << queue->Dropped() << "  processed "
+              << queue->Processed() << "  applied " << queue->Applied();
+  }
+  size_t left = 0;
+  for (uint64_t k = 1ULL << 40; k < (1ULL << 40) + kQueriesPerThread; k++) {
+    left += filter.Contain(k) == cuckoofilter::Ok;
+  }
+  std::cout << "  false positives left " << left << std::endl;
+}
+
+void Bench(const size_t log_keys, const unsigned threads) {
+  const size_t n = (1ULL << log_keys) * 0.9;
+  Filter inline_filter(1ULL << log_keys);
+  Filter queued_filter(1ULL << log_keys);
+  for (size_t k = 0; k < n; k++) {
+    inline_filter.Add(k);
+    queued_filter.Add(k);
+  }
+  inline_filter.SetConcurrent(true);
+  queued_filter.SetConcurrent(true);
+  Run("inline", inline_filter, NULL, threads);
+  AdaptationQueue<Filter> queue(queued_filter);
+  Run("queued", queued_filter, &queue, threads);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20;
+  const unsigned cores =
+      (argc > 2) ? strtoul(argv[2], NULL, 10)
+                 : std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    Bench(log_keys, threads);
+    if (threads == cores) {
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Builds a CuckooFilterChangeFLength from random keys with an Add() loop and
+// with BulkBuild() on 1, 2, 4, ... threads up to the number of cores.
+//
+// Usage: bulk-build [number of keys, default 2^22 * 0.95]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12> Filter;
+
+void Report(const char *name, const unsigned threads, const size_t n,
+            const std::chrono::steady_clock::time_point start,
+            const Filter &filter) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::setw(10) << name << std::setw(4) << threads
+            << " threads  " << std::fixed << std::setprecision(3)
+            << elapsed.count() << " s  " << std::setprecision(1)
+            << n / elapsed.count() / 1e6 << " Mkeys/s  load "
+            << std::setprecision(4) << filter.LoadFactor() << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10)
+                              : (size_t)((1 << 22) * 0.95);
+  std::vector<uint64_t> keys(n);
+  std::mt19937_64 rng(n);
+  for (size_t k = 0; k < n; k++) {
+    keys[k] = rng();
+  }
+
+  {
+    Filter filter(n);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < n; k++) {
+      filter.Add(keys[k]);
+    }
+    Report("Add", 1, n, start, filter);
+  }
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    Filter filter(n);
+    auto start = std::chrono::steady_clock::now();
+    filter.BulkBuild(keys.data(), n, threads);
+    Report("BulkBuild", threads, n, start, filter);
+    if (threads == cores) {
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,161 @@
+// A CuckooFilterChangeFLength whose keys stay in a map of the caller, the
+// way SingleTableWithSource is meant to be used with a key-value store:
+// Source reads and writes the map, the filter keeps only the buckets.
+//
+// The filter is filled to 95% load, so most inserts kick, and then
+//
+//   checks that every key is found by Contain() and ContainExact(),
+//   ChangeFingerprint()s every false positive of keys not in it and checks
+//   that no key is lost, and
+//   Delete()s half of the keys and checks that only those are gone,
+//
+// for both insert modes. It prints how many Fetch() calls and buckets each
+// step took, and exits with 1 if a check fails.
+//
+// Usage: callback-store [log2 number of keys, default 18]
+
+#include <stdlib.h>
+
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithSource;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+const size_t kQueries = 1 << 20;
+
+// the key in each slot of the filter, by 4 * bucket + slot
+struct MapSource {
+  std::unordered_map<uint64_t, uint64_t> keys;
+  size_t fetches;
+  size_t fetched;
+
+  MapSource() : fetches(0), fetched(0) {}
+
+  void Fetch(const size_t *buckets, size_t n, uint64_t *items) {
+    fetches++;
+    fetched += n;
+    for (size_t k = 0; k < n; k++) {
+      for (size_t j = 0; j < 4; j++) {
+        std::unordered_map<uint64_t, uint64_t>::const_iterator it =
+            keys.find(4 * buckets[k] + j);
+        items[4 * k + j] = (it != keys.end()) ? it->second : 0;
+      }
+    }
+  }
+
+  void Store(size_t bucket, size_t slot, uint64_t item) {
+    if (item == 0) {
+      keys.erase(4 * bucket + slot);
+    } else {
+      keys[4 * bucket + slot] = item;
+    }
+  }
+};
+
+typedef CuckooFilterChangeFLength<uint64_t, 12,
+                                  SingleTableWithSource<MapSource>::Table>
+    Filter;
+
+uint64_t Key(const uint64_t k) { return k * 0x9e3779b97f4a7c15ULL + 1; }
+
+bool failed = false;
+
+void Check(const bool ok, const char *what) {
+  if (!ok) {
+    std::cout << "FAILED: " << what << std::endl;
+    failed = true;
+  }
+}
+
+// every entry but the victim, if there is one, has its key in the map
+bool InMap(const MapSource &source, const Filter &filter) {
+  return source.keys.size() <= filter.Size() &&
+         source.keys.size() + 1 >= filter.Size();
+}
+
+// the Fetch() calls and buckets since the last report
+void Report(const char *step, MapSource *source, const size_t ops) {
+  std::cout << "  " << std::setw(18) << std::left << step << std::right
+            << std::setw(9) << source->fetches << " fetches, "
+            << std::setw(9) << source->fetched << " buckets for "
+            << std::setw(8) << ops << " ops" << std::endl;
+  source->fetches = 0;
+  source->fetched = 0;
+}
+
+void Run(const char *name, const cuckoofilter::InsertMode mode,
+         const size_t log_keys) {
+  const size_t n = (1ULL << log_keys) * 0.95;
+  MapSource source;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1), &source);
+  filter.SetInsertMode(mode);
+  std::cout << name << std::endl;
+
+  size_t added = 0;
+  for (uint64_t k = 0; k < n; k++) {
+    added += (filter.Add(Key(k)) == cuckoofilter::Ok);
+  }
+  Check(added == n, "add");
+  Check(InMap(source, filter), "one key in the map per entry");
+  Report("add", &source, n);
+
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter.ContainExact(Key(k)) != cuckoofilter::Ok) {
+      Check(false, "ContainExact after kicks");
+      break;
+    }
+  }
+  Report("ContainExact", &source, n);
+
+  size_t false_positives = 0;
+  for (uint64_t k = n; k < n + kQueries; k++) {
+    if (filter.Contain(Key(k)) == cuckoofilter::Ok) {
+      false_positives++;
+      filter.ChangeFingerprint(Key(k));
+    }
+  }
+  Report("ChangeFingerprint", &source, false_positives);
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter.Contain(Key(k)) != cuckoofilter::Ok) {
+      Check(false, "Contain after ChangeFingerprint");
+      break;
+    }
+  }
+
+  for (uint64_t k = 0; k < n; k += 2) {
+    if (filter.Delete(Key(k)) != cuckoofilter::Ok) {
+      Check(false, "Delete");
+      break;
+    }
+  }
+  Report("Delete", &source, n / 2);
+  for (uint64_t k = 0; k < n; k++) {
+    const cuckoofilter::Status expected =
+        (k % 2 == 0) ? cuckoofilter::NotFound : cuckoofilter::Ok;
+    if (filter.ContainExact(Key(k)) != expected) {
+      Check(false, "ContainExact after Delete");
+      break;
+    }
+  }
+  Check(InMap(source, filter), "one key in the map per entry after Delete");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 18;
+  Run("RandomWalk", cuckoofilter::RandomWalk, log_keys);
+  Run("PathSearch", cuckoofilter::PathSearch, log_keys);
+  if (!failed) {
+    std::cout << "ok" << std::endl;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+// Contain() throughput of 1, 2, 4, ... reader threads up to the number of
+// cores, while one writer thread keeps adding and deleting keys:
+//
+//   mutex:      a plain filter with every call under one std::mutex
+//   concurrent: a filter in SetConcurrent() mode, readers take no lock
+//
+// Usage: concurrent-contain [log2 number of keys, default 20] [seconds per
+//                           run, default 1]
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12> Filter;
+
+void Bench(const char *name, const bool concurrent, const size_t log_keys,
+           const unsigned readers, const double seconds) {
+  const size_t n = (1ULL << log_keys) * 0.8;
+  Filter filter(1ULL << log_keys);
+  std::vector<uint64_t> keys(n);
+  std::mt19937_64 rng(n);
+  for (size_t k = 0; k < n; k++) {
+    keys[k] = rng();
+    filter.Add(keys[k]);
+  }
+  filter.SetConcurrent(concurrent);
+  std::mutex mutex;
+  std::atomic<bool> stop(false);
+  std::vector<size_t> queries(readers * 8, 0);
+  size_t writes = 0;
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < readers; t++) {
+    threads.push_back(std::thread([&, t]() {
+      std::mt19937_64 keyrng(t);
+      size_t count = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        const uint64_t key = keys[keyrng() % n];
+        if (concurrent) {
+          filter.Contain(key);
+        } else {
+          std::lock_guard<std::mutex> lock(mutex);
+          filter.Contain(key);
+        }
+        count++;
+      }
+      // one cache line apart
+      queries[t * 8] = count;
+    }));
+  }
+  threads.push_back(std::thread([&]() {
+    std::mt19937_64 keyrng(n + 1);
+    while (!stop.load(std::memory_order_relaxed)) {
+      const uint64_t key = keyrng();
+      std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+      if (!concurrent) {
+        lock.lock();
+      }
+      filter.Add(key);
+      filter.Delete(key);
+      writes += 2;
+    }
+  }));
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+
+  size_t total = 0;
+  for (unsigned t = 0; t < readers; t++) {
+    total += queries[t * 8];
+  }
+  std::cout << std::setw(10) << name << std::setw(4) << readers
+            << " readers  " << std::fixed << std::setprecision(2)
+            << total / seconds / 1e6 << " Mqueries/s  "
+            << writes / seconds / 1e6 << " Mwrites/s" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20;
+  const double seconds = (argc > 2) ? atof(argv[2]) : 1;
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned readers = 1;; readers = std::min(readers * 2, cores)) {
+    Bench("mutex", false, log_keys, readers, seconds);
+    Bench("concurrent", true, log_keys, readers, seconds);
+    if (readers == cores) {
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Fills a CuckooFilter to 90% from 1, 2, 4, ... producer threads up to the
+// number of cores (or the thread count given) and reports the insert rate:
+//
+//   mutex:      SingleTable, every Add under one std::mutex
+//   concurrent: ConcurrentSingleTable, lock-free Add into free slots
+//
+// As a stress test one more thread keeps probing keys added before the
+// run, and every key whose Add returned Ok is looked up at the end; any
+// miss is reported.
+//
+// Usage: concurrent-insert [log2 number of keys, default 22] [max threads]
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilter.h"
+
+using cuckoofilter::ConcurrentSingleTable;
+using cuckoofilter::CuckooFilter;
+using cuckoofilter::SingleTable;
+
+namespace {
+
+template <template <size_t> class TableType>
+void Bench(const char *name, const bool lock, const std::vector<uint64_t> &keys,
+           const size_t resident, const unsigned threads) {
+  // 2^k slots, so that keys fill 90% of them
+  CuckooFilter<uint64_t, 12, TableType> filter(keys.size() / 0.9 *
+                                               cuckoofilter::kTargetLoadFactor);
+  for (size_t k = 0; k < resident; k++) {
+    filter.Add(keys[k]);
+  }
+  std::mutex mutex;
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> reader_misses(0);
+  std::vector<uint8_t> added(keys.size(), 1);
+
+  std::thread reader([&]() {
+    std::mt19937_64 rng(threads);
+    while (!stop.load(std::memory_order_relaxed)) {
+      std::unique_lock<std::mutex> guard(mutex, std::defer_lock);
+      if (lock) {
+        guard.lock();
+      }
+      if (filter.Contain(keys[rng() % resident]) != cuckoofilter::Ok) {
+        reader_misses++;
+      }
+    }
+  });
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (unsigned t = 0; t < threads; t++) {
+    producers.push_back(std::thread([&, t]() {
+      for (size_t k = resident + t; k < keys.size(); k += threads) {
+        cuckoofilter::Status status;
+        if (lock) {
+          std::lock_guard<std::mutex> guard(mutex);
+          status = filter.Add(keys[k]);
+        } else {
+          status = filter.Add(keys[k]);
+        }
+        added[k] = status == cuckoofilter::Ok;
+      }
+    }));
+  }
+  for (unsigned t = 0; t < threads; t++) {
+    producers[t].join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  stop = true;
+  reader.join();
+
+  size_t failed = 0, misses = 0;
+  for (size_t k = 0; k < keys.size(); k++) {
+    failed += !added[k];
+    misses += added[k] && filter.Contain(keys[k]) != cuckoofilter::Ok;
+  }
+  std::cout << std::setw(10) << name << std::setw(4) << threads
+            << " threads  " << std::fixed << std::setprecision(2)
+            << (keys.size() - resident) / elapsed.count() / 1e6
+            << " Mkeys/s  failed " << failed << "  misses " << misses
+            << "  reader misses " << reader_misses << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 22;
+  const unsigned cores =
+      (argc > 2) ? strtoul(argv[2], NULL, 10)
+                 : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint64_t> keys((1ULL << log_keys) * 0.9);
+  std::mt19937_64 rng(log_keys);
+  for (size_t k = 0; k < keys.size(); k++) {
+    keys[k] = rng();
+  }
+  const size_t resident = keys.size() / 4;
+
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    Bench<SingleTable>("mutex", true, keys, resident, threads);
+    Bench<ConcurrentSingleTable>("concurrent", false, keys, resident,
+                                 threads);
+    if (threads == cores) {
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Insert and adapt throughput of a CuckooFilterChangeFLength with its keys
+// in memory (KeyStore) and in a file (FileStore):
+//
+//   insert: Add() until the filter is 95% full
+//   adapt:  ChangeFingerprint() on every false positive of keys not in it
+//
+// Both filters use the same seed, so they do the same work. The file is
+// made in the directory given, e.g. on an NVMe drive or a tmpfs, and goes
+// away at exit. Contain() does not touch the item store and is not timed.
+//
+// Usage: file-store [log2 number of keys, default 22] [directory, default
+//                   $TMPDIR or /tmp]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::SingleTableWithFile;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+const size_t kQueries = 1 << 24;
+
+double Seconds(const std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template <template <size_t> class TableType>
+void Bench(const char *name, const size_t log_keys) {
+  const size_t n = (1ULL << log_keys) * 0.95;
+  srand(1);
+  CuckooFilterChangeFLength<uint64_t, 12, TableType> filter(
+      n, 0, TwoIndependentMultiplyShift(1));
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t k = 0; k < n; k++) {
+    filter.Add(k * 0x9e3779b97f4a7c15ULL);
+  }
+  const double insert = Seconds(start);
+
+  std::vector<uint64_t> false_positives;
+  for (uint64_t k = 1ULL << 40; k < (1ULL << 40) + kQueries; k++) {
+    if (filter.Contain(k) == cuckoofilter::Ok) {
+      false_positives.push_back(k);
+    }
+  }
+  start = std::chrono::steady_clock::now();
+  for (size_t k = 0; k < false_positives.size(); k++) {
+    filter.ChangeFingerprint(false_positives[k]);
+  }
+  const double adapt = Seconds(start);
+
+  std::cout << std::setw(8) << name << std::fixed << std::setprecision(2)
+            << "  insert " << n / insert / 1e6 << " Mkeys/s  adapt "
+            << false_positives.size() / adapt / 1e6 << " Mkeys/s ("
+            << false_positives.size() << " false positives)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 22;
+  if (argc > 2) {
+    setenv("TMPDIR", argv[2], 1);
+  }
+  Bench<SingleTableWithEncode>("memory", log_keys);
+  Bench<SingleTableWithFile<>::Table>("file", log_keys);
+  return 0;
+}
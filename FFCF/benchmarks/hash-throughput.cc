@@ -0,0 +1,114 @@
+// Throughput of the string hashes of HashUtil over keys of 4 to 4096 bytes,
+// in millions of keys and in GB per second, and of the HashFamily classes
+// on 64-bit integer keys. The string hashes are what KeyDigest() runs on
+// string keys, the integer ones what the filters run on every digest.
+//
+// Usage: hash-throughput [MB of keys per length, default 64]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hashutil.h"
+
+using cuckoofilter::Crc32cHashFamily;
+using cuckoofilter::HashUtil;
+using cuckoofilter::SimpleTabulation;
+using cuckoofilter::TwoIndependentMultiplyShift;
+using cuckoofilter::WyHashFamily;
+
+namespace {
+
+const size_t kLengths[] = {4, 8, 16, 32, 64, 256, 1024, 4096};
+const size_t kIntegerKeys = 1 << 24;
+
+double Seconds(const std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// hashes the keys of length len laid out back to back in buf
+template <typename Hash>
+void BenchBytes(const char *name, Hash hash, const std::vector<char> &buf) {
+  std::cout << std::setw(14) << name;
+  for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+    const size_t len = kLengths[l];
+    const size_t n = buf.size() / len;
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < n; k++) {
+      sum += hash(&buf[k * len], len);
+    }
+    const double elapsed = Seconds(start);
+    std::cout << std::setw(9) << std::fixed << std::setprecision(1)
+              << n / elapsed / 1e6 << "/" << std::setw(4)
+              << std::setprecision(1) << buf.size() / elapsed / 1e9;
+    // keep the hashing from being optimized away
+    if (sum == 42) {
+      std::cout << "!";
+    }
+  }
+  std::cout << std::endl;
+}
+
+template <typename HashFamily>
+void BenchIntegers(const char *name) {
+  HashFamily hasher;
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t k = 0; k < kIntegerKeys; k++) {
+    sum += hasher(k);
+  }
+  const double elapsed = Seconds(start);
+  std::cout << std::setw(28) << name << "  " << std::fixed
+            << std::setprecision(1) << kIntegerKeys / elapsed / 1e6
+            << " Mhashes/s" << (sum == 42 ? "!" : "") << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t mb = (argc > 1) ? strtoul(argv[1], NULL, 10) : 64;
+  std::vector<char> buf(mb << 20);
+  std::mt19937_64 rng(mb);
+  for (size_t i = 0; i < buf.size(); i++) {
+    buf[i] = rng();
+  }
+
+  std::cout << "Mkeys/s / GB/s by key length in bytes:" << std::endl;
+  std::cout << std::setw(14) << "";
+  for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+    std::cout << std::setw(14) << kLengths[l];
+  }
+  std::cout << std::endl;
+  BenchBytes("BobHash", [](const void *p, size_t len) {
+    return HashUtil::BobHash(p, len);
+  }, buf);
+  BenchBytes("MurmurHash", [](const void *p, size_t len) {
+    return HashUtil::MurmurHash(p, len);
+  }, buf);
+  BenchBytes("SuperFastHash", [](const void *p, size_t len) {
+    return HashUtil::SuperFastHash(p, len);
+  }, buf);
+  BenchBytes("MurmurHash64A", [](const void *p, size_t len) {
+    return HashUtil::MurmurHash64A(p, len);
+  }, buf);
+  BenchBytes("WyHash", [](const void *p, size_t len) {
+    return HashUtil::WyHash(p, len);
+  }, buf);
+  BenchBytes("Crc32cHash", [](const void *p, size_t len) {
+    return HashUtil::Crc32cHash(p, len);
+  }, buf);
+
+  std::cout << std::endl << "64-bit integer keys:" << std::endl;
+  BenchIntegers<TwoIndependentMultiplyShift>("TwoIndependentMultiplyShift");
+  BenchIntegers<SimpleTabulation>("SimpleTabulation");
+  BenchIntegers<WyHashFamily>("WyHashFamily");
+  BenchIntegers<Crc32cHashFamily>("Crc32cHashFamily");
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Fills a CuckooFilterChangeFLength until its first failed insert, once per
+// InsertMode, and reports the load factor reached plus the latency of the
+// inserts made above 90% occupancy.
+//
+// Usage: insert-path [log2 number of keys the filter is sized for, def. 20]
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::InsertMode;
+using cuckoofilter::PathSearch;
+using cuckoofilter::RandomWalk;
+
+namespace {
+
+void Bench(const char *name, const InsertMode mode, const size_t num_keys) {
+  CuckooFilterChangeFLength<uint64_t, 12> filter(num_keys);
+  filter.SetInsertMode(mode);
+  std::mt19937_64 rng(num_keys);
+  std::vector<double> latencies;
+
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    const size_t before = filter.Size();
+    const bool tail = filter.LoadFactor() >= 0.9;
+    auto t0 = std::chrono::steady_clock::now();
+    filter.Add(rng());
+    auto t1 = std::chrono::steady_clock::now();
+    // the item went to the victim cache
+    if (filter.Size() == before) {
+      break;
+    }
+    if (tail) {
+      latencies.push_back(
+          std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::sort(latencies.begin(), latencies.end());
+  const size_t n = latencies.size();
+  std::cout << std::setw(12) << name << std::fixed << std::setprecision(4)
+            << "  load " << filter.LoadFactor() << std::setprecision(2)
+            << "  fill " << elapsed.count() << " s";
+  if (n > 0) {
+    std::cout << std::setprecision(0) << "  >90% ns p50 "
+              << latencies[n / 2] << " p99 " << latencies[n * 99 / 100]
+              << " p99.9 " << latencies[n * 999 / 1000] << " max "
+              << latencies[n - 1];
+  }
+  std::cout << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20;
+  Bench("RandomWalk", RandomWalk, 1ULL << log_keys);
+  Bench("PathSearch", PathSearch, 1ULL << log_keys);
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Writes a CuckooFilterChangeFLength to a file, then loads it back with
+// Deserialize() and with Map(), and reports the load time plus the rate of
+// Contain() on random keys against either copy. The first pass over the
+// view takes the page faults that map its buckets in.
+//
+// Usage: map-load [log2 number of keys, default 22] [file, default
+//                 /tmp/map-load.filter]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "cuckoofilterchange.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12> Filter;
+
+const size_t kQueries = 1 << 20;
+
+double Seconds(const std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+void Probe(const char *name, const Filter &filter, const uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  size_t hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t q = 0; q < kQueries; q++) {
+    hits += filter.Contain(rng()) == cuckoofilter::Ok;
+  }
+  double elapsed = Seconds(start);
+  std::cout << std::setw(16) << name << "  " << std::fixed
+            << std::setprecision(1) << kQueries / elapsed / 1e6
+            << " Mqueries/s  (" << hits << " hits)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 22;
+  const char *path = (argc > 2) ? argv[2] : "/tmp/map-load.filter";
+  const size_t n = (1ULL << log_keys) * 0.9;
+
+  {
+    Filter filter(n);
+    std::mt19937_64 rng(n);
+    for (size_t k = 0; k < n; k++) {
+      filter.Add(rng());
+    }
+    std::ofstream out(path, std::ios::binary);
+    if (filter.Serialize(out) != cuckoofilter::Ok) {
+      std::cerr << "cannot write " << path << std::endl;
+      return 1;
+    }
+  }
+
+  Filter loaded(1);
+  auto start = std::chrono::steady_clock::now();
+  std::ifstream in(path, std::ios::binary);
+  loaded.Deserialize(in);
+  std::cout << std::setw(16) << "Deserialize" << "  " << std::fixed
+            << std::setprecision(6) << Seconds(start) << " s  "
+            << (loaded.SizeInBytes() >> 20) << " MB buckets" << std::endl;
+
+  Filter mapped(1);
+  start = std::chrono::steady_clock::now();
+  if (mapped.Map(path) != cuckoofilter::Ok) {
+    std::cerr << "cannot map " << path << std::endl;
+    return 1;
+  }
+  std::cout << std::setw(16) << "Map" << "  " << std::fixed
+            << std::setprecision(6) << Seconds(start) << " s" << std::endl;
+
+  Probe("mapped 1st pass", mapped, 1);
+  Probe("mapped 2nd pass", mapped, 2);
+  Probe("loaded", loaded, 2);
+  return 0;
+}
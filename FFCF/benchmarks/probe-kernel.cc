@@ -0,0 +1,140 @@
+// Compares the lookup kernels of SingleTableWithEncode on random probes:
+//
+//   readtag:   the per-slot ReadTag() lookup, branching on the occupancy
+//   occupancy: FindTagInBucketsByOccupancy(), the same on one bucket word
+//   scalar:    FindTagInBucketsScalar(), branch-free
+//   avx2:      FindTagInBucketsAVX2(), when built with -mavx2
+//
+// Usage: probe-kernel [log2 number of buckets, default 16]
+// Build with OPT = -O3 -DNDEBUG -march=native in the Makefile.
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "singletablewithencode.h"
+
+using cuckoofilter::SingleTableWithEncode;
+
+namespace {
+
+const size_t kNumProbes = 1 << 16;
+const size_t kRounds = 64;
+
+struct Entry {
+  size_t i;
+  uint32_t tag;
+};
+
+struct Probe {
+  size_t i1, i2;
+  uint32_t tag;
+};
+
+// FindTagInBuckets as it was written against ReadTag()
+template <size_t bits_per_tag>
+bool FindByOccupancy(const SingleTableWithEncode<bits_per_tag> &table,
+                     const size_t i, const uint32_t tag) {
+  const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+  uint32_t tagshort = tag & kTagMask;
+  tagshort += (tagshort == 0);
+  uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+  tagshorthigh += (tagshorthigh == 0);
+  uint32_t a = table.ReadTag(i, 4);
+  if (a == 1) {
+    return table.ReadTag(i, 0) == tag;
+  }
+  if (a == 2) {
+    return (table.ReadTag(i, 0) == tag) || (table.ReadTag(i, 2) == tag);
+  }
+  if (a == 3) {
+    return (table.ReadTag(i, 0) == tagshort) ||
+           (table.ReadTag(i, 1) == tagshorthigh) ||
+           (table.ReadTag(i, 2) == tag);
+  }
+  if (a == 4) {
+    return (table.ReadTag(i, 0) == tagshort) ||
+           (table.ReadTag(i, 1) == tagshorthigh) ||
+           (table.ReadTag(i, 2) == tagshort) ||
+           (table.ReadTag(i, 3) == tagshorthigh);
+  }
+  return false;
+}
+
+template <typename F>
+void Run(const char *name, const std::vector<Probe> &probes, F find) {
+  auto start = std::chrono::steady_clock::now();
+  size_t hits = 0;
+  for (size_t r = 0; r < kRounds; r++) {
+    for (size_t k = 0; k < probes.size(); k++) {
+      hits += find(probes[k]);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::nano> elapsed = end - start;
+  std::cout << "  " << std::setw(10) << name << std::setw(10) << std::fixed
+            << std::setprecision(2) << elapsed.count() / probes.size() / kRounds
+            << " ns/probe  hits: " << hits << std::endl;
+}
+
+template <size_t bits_per_tag>
+void Bench(const size_t log_buckets) {
+  const size_t num_buckets = 1ULL << log_buckets;
+  const uint32_t kTwoTagMask = (1ULL << (2 * bits_per_tag)) - 1;
+  SingleTableWithEncode<bits_per_tag> table(num_buckets);
+  std::mt19937_64 rng(bits_per_tag);
+
+  // fill to ~90% with a spread of occupancies, without kicks
+  std::vector<Entry> entries;
+  uint32_t oldtag;
+  uint64_t olditem;
+  for (size_t n = 0; n < num_buckets * 4 * 9 / 10; n++) {
+    Entry e = {(size_t)(rng() & (num_buckets - 1)),
+               (uint32_t)((rng() & kTwoTagMask) | 1)};
+    if (table.InsertTagToBucket(e.i, e.tag, false, oldtag, rng(), olditem)) {
+      entries.push_back(e);
+    }
+  }
+
+  // half of the probes look up an entry in its own bucket, in random order
+  // so that the branchy kernel cannot learn the outcome
+  std::vector<Probe> probes(kNumProbes);
+  for (size_t k = 0; k < kNumProbes; k++) {
+    const Entry &e = entries[rng() % entries.size()];
+    probes[k].i1 = (rng() & 1) ? e.i : rng() & (num_buckets - 1);
+    probes[k].i2 = rng() & (num_buckets - 1);
+    probes[k].tag = e.tag;
+  }
+
+  std::cout << bits_per_tag << "-bit tags, " << num_buckets << " buckets"
+            << std::endl;
+  Run("readtag", probes, [&](const Probe &p) {
+    return FindByOccupancy(table, p.i1, p.tag) ||
+           FindByOccupancy(table, p.i2, p.tag);
+  });
+  Run("occupancy", probes, [&](const Probe &p) {
+    return table.FindTagInBucketsByOccupancy(p.i1, p.i2, p.tag);
+  });
+  Run("scalar", probes, [&](const Probe &p) {
+    return table.FindTagInBucketsScalar(p.i1, p.i2, p.tag);
+  });
+#if defined(__AVX2__)
+  Run("avx2", probes, [&](const Probe &p) {
+    return table.FindTagInBucketsAVX2(p.i1, p.i2, p.tag);
+  });
+#endif
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t log_buckets = (argc > 1) ? strtoul(argv[1], NULL, 10) : 16;
+  Bench<8>(log_buckets);
+  Bench<12>(log_buckets);
+  Bench<16>(log_buckets);
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Mixed Add/Contain/Delete throughput of 1, 2, 4, ... threads up to the
+// number of cores (or the thread count given) on CuckooFilterChangeFLength:
+//
+//   mutex:   one filter with every call under one std::mutex
+//   sharded: ShardedCuckooFilter with 16 shards, one lock per shard
+//
+// Usage: sharded [log2 number of keys, default 22] [max threads]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+#include "shardedcuckoofilter.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::ShardedCuckooFilter;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12> Filter;
+
+// the single-lock baseline, with the API of ShardedCuckooFilter
+class LockedFilter {
+  std::mutex mutex_;
+  Filter filter_;
+
+ public:
+  explicit LockedFilter(const size_t max_num_keys) : filter_(max_num_keys) {}
+
+  cuckoofilter::Status Add(const uint64_t key) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return filter_.Add(key);
+  }
+
+  cuckoofilter::Status Contain(const uint64_t key) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return filter_.Contain(key);
+  }
+
+  cuckoofilter::Status Delete(const uint64_t key) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return filter_.Delete(key);
+  }
+};
+
+// every thread adds its share of the keys, looks each up and deletes half
+template <typename F>
+void Bench(const char *name, const std::vector<uint64_t> &keys,
+           const unsigned threads) {
+  F filter(keys.size());
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  std::vector<size_t> misses(threads * 8, 0);
+  for (unsigned t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      size_t miss = 0;
+      for (size_t k = t; k < keys.size(); k += threads) {
+        filter.Add(keys[k]);
+      }
+      for (size_t k = t; k < keys.size(); k += threads) {
+        miss += filter.Contain(keys[k]) != cuckoofilter::Ok;
+      }
+      for (size_t k = t; k < keys.size(); k += 2 * threads) {
+        filter.Delete(keys[k]);
+      }
+      // one cache line apart
+      misses[t * 8] = miss;
+    }));
+  }
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t miss = 0;
+  for (unsigned t = 0; t < threads; t++) {
+    miss += misses[t * 8];
+  }
+  std::cout << std::setw(10) << name << std::setw(4) << threads
+            << " threads  " << std::fixed << std::setprecision(2)
+            << keys.size() * 2.5 / elapsed.count() / 1e6
+            << " Mops/s  misses " << miss << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t log_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 22;
+  const unsigned cores =
+      (argc > 2) ? strtoul(argv[2], NULL, 10)
+                 : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint64_t> keys((1ULL << log_keys) * 0.9);
+  std::mt19937_64 rng(log_keys);
+  for (size_t k = 0; k < keys.size(); k++) {
+    keys[k] = rng();
+  }
+
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    Bench<LockedFilter>("mutex", keys, threads);
+    Bench<ShardedCuckooFilter<Filter, 16> >("sharded", keys, threads);
+    if (threads == cores) {
+      break;
+    }
+  }
+  return 0;
+}
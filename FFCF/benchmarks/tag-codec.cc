@@ -0,0 +1,192 @@
+// Throughput and retired instructions of the tag read/write paths:
+//
+//   read:   ReadTag() of every slot and the occupancy of random buckets
+//   write:  InsertTagToBucket() / DeleteTagFromBucket() churn on random
+//           buckets, which goes through WriteTag()
+//   filter: Add, Contain and Delete of a CuckooFilterChangeFLength
+//
+// It only uses interfaces that predate the table-driven ReadTag/WriteTag, so
+// the numbers of an older revision come from building this same file
+// against that revision's src/:
+//
+//   g++ -O3 -DNDEBUG -march=native -I<old checkout>/src
+//       benchmarks/tag-codec.cc <old checkout>/src/hashutil.cc
+//       -lssl -lcrypto -o tag-codec-old
+//
+// Instruction counts use perf_event_open and show as "-" where the kernel
+// does not allow it.
+//
+// Usage: tag-codec [log2 number of buckets, default 16]
+
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+#include "singletable.h"
+
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTable;
+using cuckoofilter::SingleTableWithEncode;
+
+namespace {
+
+const size_t kNumOps = 1 << 20;
+
+class InstructionCounter {
+  int fd_;
+
+ public:
+  InstructionCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~InstructionCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  void Start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  // instructions since Start(), or -1 without a counter
+  long long Stop() {
+    long long count = -1;
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = -1;
+      }
+    }
+    return count;
+  }
+};
+
+InstructionCounter counter;
+volatile uint64_t sink;
+
+template <typename F>
+void Run(const char *name, const size_t ops, F body) {
+  counter.Start();
+  auto start = std::chrono::steady_clock::now();
+  body();
+  auto end = std::chrono::steady_clock::now();
+  long long instructions = counter.Stop();
+  std::chrono::duration<double, std::nano> elapsed = end - start;
+  std::cout << "  " << std::setw(16) << std::left << name << std::right
+            << std::setw(8) << std::fixed << std::setprecision(2)
+            << elapsed.count() / ops << " ns/op  " << std::setw(8);
+  if (instructions >= 0) {
+    std::cout << std::setprecision(1) << 1.0 * instructions / ops;
+  } else {
+    std::cout << "-";
+  }
+  std::cout << " insns/op" << std::endl;
+}
+
+template <typename Table>
+void BenchTable(const char *title, const size_t bits,
+                const size_t log_buckets) {
+  const size_t num_buckets = 1ULL << log_buckets;
+  const uint32_t tag_mask = (1ULL << bits) - 1;
+  Table table(num_buckets);
+  std::mt19937_64 rng(bits);
+  std::vector<size_t> buckets(kNumOps);
+  std::vector<uint32_t> tags(kNumOps);
+  for (size_t k = 0; k < kNumOps; k++) {
+    buckets[k] = rng() & (num_buckets - 1);
+    tags[k] = (rng() & tag_mask) | 1;
+  }
+
+  std::cout << title << ", " << num_buckets << " buckets" << std::endl;
+  uint32_t oldtag;
+  uint64_t olditem;
+  Run("write", 2 * kNumOps, [&]() {
+    for (size_t k = 0; k < kNumOps; k++) {
+      table.InsertTagToBucket(buckets[k], tags[k], false, oldtag, k, olditem);
+    }
+    for (size_t k = 0; k < kNumOps; k++) {
+      table.DeleteTagFromBucket(buckets[k], tags[k]);
+    }
+  });
+  // leave the table about half full for the reads
+  for (size_t k = 0; k < num_buckets * 2; k++) {
+    table.InsertTagToBucket(buckets[k % kNumOps], tags[k % kNumOps], false,
+                            oldtag, k, olditem);
+  }
+  Run("read", kNumOps, [&]() {
+    uint64_t sum = 0;
+    for (size_t k = 0; k < kNumOps; k++) {
+      for (size_t j = 0; j < 4; j++) {
+        sum += table.ReadTag(buckets[k], j);
+      }
+    }
+    sink = sum;
+  });
+}
+
+template <size_t bits_per_item>
+void BenchFilter(const size_t log_buckets) {
+  const size_t num_keys = (1ULL << log_buckets) * 4 * 9 / 10;
+  CuckooFilterChangeFLength<uint64_t, bits_per_item> filter(num_keys);
+  std::cout << "CuckooFilterChangeFLength<" << bits_per_item << ">, "
+            << num_keys << " keys" << std::endl;
+  Run("add", num_keys, [&]() {
+    for (size_t k = 0; k < num_keys; k++) {
+      filter.Add(k);
+    }
+  });
+  Run("contain", 2 * num_keys, [&]() {
+    uint64_t found = 0;
+    for (size_t k = 0; k < 2 * num_keys; k++) {
+      found += filter.Contain(k) == cuckoofilter::Ok;
+    }
+    sink = found;
+  });
+  Run("delete", num_keys, [&]() {
+    for (size_t k = 0; k < num_keys; k++) {
+      filter.Delete(k);
+    }
+  });
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t log_buckets = (argc > 1) ? strtoul(argv[1], NULL, 10) : 16;
+  BenchTable<SingleTable<8> >("SingleTable<8>", 8, log_buckets);
+  BenchTable<SingleTable<12> >("SingleTable<12>", 12, log_buckets);
+  BenchTable<SingleTable<16> >("SingleTable<16>", 16, log_buckets);
+  BenchTable<SingleTableWithEncode<8> >("SingleTableWithEncode<8>", 16,
+                                        log_buckets);
+  BenchTable<SingleTableWithEncode<12> >("SingleTableWithEncode<12>", 24,
+                                         log_buckets);
+  BenchTable<SingleTableWithEncode<16> >("SingleTableWithEncode<16>", 32,
+                                         log_buckets);
+  BenchFilter<8>(log_buckets);
+  BenchFilter<12>(log_buckets);
+  BenchFilter<16>(log_buckets);
+  return 0;
+}
@@ -0,0 +1,70 @@
+// ContainProbe() and AdaptAt() on the false positives of a full filter:
+// every key added stays found, most false positives are gone, and the
+// filter ends up as ChangeFingerprint() of the same keys leaves it. A
+// handle from before a Grow() adapts nothing.
+
+#include <sstream>
+#include <string>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::FalsePositives;
+using check::FindsAll;
+using check::Key;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode> Filter;
+
+std::string Bytes(const Filter &filter) {
+  std::stringstream out;
+  filter.Serialize(out);
+  return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t n = check::kSlots * 0.95;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&filter, Key, n);
+  srand(1);
+  Filter changed(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&changed, Key, n);
+
+  const size_t before = FalsePositives(filter, Key, n);
+  size_t adapted = 0, mismatches = 0;
+  for (uint64_t k = n; k < n + check::kQueries; k++) {
+    Filter::ProbeHandle handle;
+    if (filter.ContainProbe(Key(k), &handle) != cuckoofilter::Ok) {
+      continue;
+    }
+    const cuckoofilter::Status status = filter.AdaptAt(handle);
+    adapted += (status == cuckoofilter::Ok);
+    mismatches += (status != changed.ChangeFingerprint(Key(k)));
+  }
+  const size_t after = FalsePositives(filter, Key, n);
+  Check(before > 0 && adapted > 0, "false positives to adapt");
+  Check(after < before / 2, "AdaptAt clears false positives");
+  Check(FindsAll(filter, Key, n, true), "keys after AdaptAt");
+  Check(mismatches == 0 && Bytes(filter) == Bytes(changed),
+        "AdaptAt == ChangeFingerprint");
+
+  // the handle points into the table before the grow
+  uint64_t k = n;
+  Filter::ProbeHandle handle;
+  while (filter.ContainProbe(Key(k), &handle) != cuckoofilter::Ok) {
+    k++;
+  }
+  filter.Grow();
+  Check(filter.AdaptAt(handle) == cuckoofilter::NotFound,
+        "AdaptAt of a handle from before Grow");
+  Check(FindsAll(filter, Key, n, true), "keys after Grow");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,97 @@
+// AdaptationQueue over a concurrent CuckooFilterChangeFLength and a
+// ShardedCuckooFilter: query threads push their false positives while the
+// worker applies them; once drained the queue is empty, every push is
+// processed or dropped, Applied() counts the changed fingerprints, and the
+// keys added are all still found.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adaptationqueue.h"
+#include "check.h"
+#include "cuckoofilterchange.h"
+#include "shardedcuckoofilter.h"
+
+using check::Check;
+using check::FalsePositives;
+using check::Key;
+using cuckoofilter::AdaptationQueue;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::ShardedCuckooFilter;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+const size_t kThreads = 4;
+
+typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode> Filter;
+
+// Contain() of every one of the n keys, which ShardedCuckooFilter answers
+template <typename Filter>
+bool ContainsAll(const Filter &filter, const size_t n) {
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter.Contain(Key(k)) != cuckoofilter::Ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Filter>
+void CheckQueue(Filter *filter, const size_t n, const std::string &name) {
+  const size_t before = FalsePositives(*filter, Key, n);
+  std::vector<size_t> pushed(kThreads);
+  {
+    AdaptationQueue<Filter> queue(*filter, 1 << 10, 64);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; t++) {
+      threads.push_back(std::thread([&, t]() {
+        for (uint64_t k = n + t; k < n + check::kQueries; k += kThreads) {
+          if (filter->Contain(Key(k)) == cuckoofilter::Ok) {
+            queue.Push(Key(k));
+            pushed[t]++;
+          }
+        }
+      }));
+    }
+    for (size_t t = 0; t < kThreads; t++) {
+      threads[t].join();
+    }
+    queue.Drain();
+    size_t total = 0;
+    for (size_t t = 0; t < kThreads; t++) {
+      total += pushed[t];
+    }
+    Check(queue.Depth() == 0, name + ": drained");
+    Check(queue.Processed() + queue.Dropped() == total,
+          name + ": every push processed or dropped");
+    Check(queue.Applied() > 0 && queue.Applied() <= queue.Processed(),
+          name + ": Applied");
+  }
+  Check(FalsePositives(*filter, Key, n) < before, name + ": false positives");
+  Check(ContainsAll(*filter, n), name + ": keys");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t n = check::kSlots * 0.95;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&filter, Key, n);
+  filter.SetConcurrent(true);
+  CheckQueue(&filter, n, "concurrent filter");
+
+  // 85%, as the shards get more or fewer keys than their share
+  const size_t m = n * 0.85 / 0.95;
+  srand(1);
+  ShardedCuckooFilter<Filter, 4> sharded(n, 0,
+                                         TwoIndependentMultiplyShift(1));
+  for (uint64_t k = 0; k < m; k++) {
+    sharded.Add(Key(k));
+  }
+  CheckQueue(&sharded, m, "sharded filter");
+  return check::Done(argv[0]);
+}
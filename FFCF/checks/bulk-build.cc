@@ -0,0 +1,85 @@
+// BulkBuild() of both filters on several threads: every key is found
+// afterwards, Size() counts them all, the false positives stay those of a
+// filter built by Add(), and a filter with keys in it takes more.
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilter.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::FalsePositives;
+using check::Key;
+using cuckoofilter::CuckooFilter;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// buckets of several BulkBuild() blocks
+const size_t kBulkSlots = 1 << 18;
+
+// Contain() of every one of the n keys, which CuckooFilter has only
+template <typename Filter>
+bool ContainsAll(const Filter &filter, const size_t n) {
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter.Contain(Key(k)) != cuckoofilter::Ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Filter>
+void CheckBulkBuild(const std::string &name, const unsigned threads) {
+  const size_t n = kBulkSlots * 0.95;
+  std::vector<uint64_t> keys;
+  for (uint64_t k = 0; k < n; k++) {
+    keys.push_back(Key(k));
+  }
+
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  Check(filter.BulkBuild(keys.data(), n, threads) == cuckoofilter::Ok,
+        name + ": BulkBuild");
+  Check(filter.Size() == n, name + ": Size");
+  Check(ContainsAll(filter, n), name + ": keys");
+
+  srand(1);
+  Filter added(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&added, Key, n);
+  const size_t fp = FalsePositives(filter, Key, n);
+  const size_t expected = FalsePositives(added, Key, n);
+  Check(fp <= 2 * expected + 16, name + ": false positives");
+
+  // half by Add(), the other half at once
+  srand(1);
+  Filter mixed(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&mixed, Key, n / 2);
+  Check(mixed.BulkBuild(keys.data() + n / 2, n - n / 2, threads) ==
+            cuckoofilter::Ok,
+        name + ": BulkBuild after Add");
+  Check(mixed.Size() == n, name + ": Size after Add");
+  Check(ContainsAll(mixed, n), name + ": keys after Add");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilter<uint64_t, 12, cuckoofilter::SingleTable,
+                       TwoIndependentMultiplyShift>
+      PlainFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const unsigned threads[] = {1, 3, 0};
+  for (size_t t = 0; t < 3; t++) {
+    const std::string suffix =
+        " on " + std::to_string(threads[t]) + " threads";
+    CheckBulkBuild<PlainFilter>("CuckooFilter" + suffix, threads[t]);
+    CheckBulkBuild<Filter>("CuckooFilterChangeFLength" + suffix, threads[t]);
+  }
+  return check::Done(argv[0]);
+}
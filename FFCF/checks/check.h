@@ -0,0 +1,154 @@
+// Helpers of the programs in checks/, each of which checks one part of the
+// filters with a fixed seed, prints every failed check and exits with 1 if
+// there is one.
+
+#ifndef CUCKOO_FILTER_CHECKS_CHECK_H_
+#define CUCKOO_FILTER_CHECKS_CHECK_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "status.h"
+
+namespace check {
+
+// slots of the filters, which 0.95 * kSlots keys fill to 95%
+const size_t kSlots = 1 << 14;
+const size_t kQueries = 1 << 16;
+
+inline bool &Failed() {
+  static bool failed = false;
+  return failed;
+}
+
+inline void Check(const bool ok, const std::string &what) {
+  if (!ok) {
+    std::cout << "FAILED: " << what << std::endl;
+    Failed() = true;
+  }
+}
+
+// the exit code of main(), printing "<program>: ok" if no check failed
+inline int Done(const char *program) {
+  if (!Failed()) {
+    std::cout << program << ": ok" << std::endl;
+  }
+  return Failed() ? 1 : 0;
+}
+
+inline uint64_t Key(const uint64_t k) {
+  return k * 0x9e3779b97f4a7c15ULL + 1;
+}
+
+// keys of 32 bits for SingleTableWithKeys<32>
+inline uint64_t ShortKey(const uint64_t k) { return (Key(k) >> 32) | 1; }
+
+// the key in each slot of a filter with a CallbackStore, by 4 * bucket + slot
+struct MapSource {
+  std::unordered_map<uint64_t, uint64_t> keys;
+  size_t stores;
+
+  MapSource() : stores(0) {}
+
+  void Fetch(const size_t *buckets, size_t n, uint64_t *items) {
+    for (size_t k = 0; k < n; k++) {
+      for (size_t j = 0; j < 4; j++) {
+        std::unordered_map<uint64_t, uint64_t>::const_iterator it =
+            keys.find(4 * buckets[k] + j);
+        items[4 * k + j] = (it != keys.end()) ? it->second : 0;
+      }
+    }
+  }
+
+  void Store(size_t bucket, size_t slot, uint64_t item) {
+    stores++;
+    if (item == 0) {
+      keys.erase(4 * bucket + slot);
+    } else {
+      keys[4 * bucket + slot] = item;
+    }
+  }
+};
+
+// a file name in $TMPDIR or /tmp that is not taken yet
+inline std::string TempPath() {
+  const char *dir = getenv("TMPDIR");
+  std::string path = std::string(dir != NULL ? dir : "/tmp") + "/check-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  const int fd = mkstemp(name.data());
+  if (fd < 0) {
+    return "";
+  }
+  close(fd);
+  return std::string(name.data());
+}
+
+// n keys from key(0) on, all added to filter
+template <typename Filter>
+bool Fill(Filter *filter, uint64_t (*key)(uint64_t), const size_t n) {
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter->Add(key(k)) != cuckoofilter::Ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Contain() of every one of the n keys, and ContainExact() if exact
+template <typename Filter>
+bool FindsAll(const Filter &filter, uint64_t (*key)(uint64_t),
+              const size_t n, const bool exact) {
+  for (uint64_t k = 0; k < n; k++) {
+    if (filter.Contain(key(k)) != cuckoofilter::Ok ||
+        (exact && filter.ContainExact(key(k)) != cuckoofilter::Ok)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the keys from key(n) on that Contain() reports, of kQueries
+template <typename Filter>
+size_t FalsePositives(const Filter &filter, uint64_t (*key)(uint64_t),
+                      const size_t n) {
+  size_t hits = 0;
+  for (uint64_t k = n; k < n + kQueries; k++) {
+    hits += (filter.Contain(key(k)) == cuckoofilter::Ok);
+  }
+  return hits;
+}
+
+// Delete() every third key, Add() the next n / 2 and check what is left
+template <typename Filter>
+void Mutate(Filter *filter, const size_t n, const std::string &name) {
+  for (uint64_t k = 0; k < n; k += 3) {
+    if (filter->Delete(Key(k)) != cuckoofilter::Ok) {
+      Check(false, name + ": Delete");
+      break;
+    }
+  }
+  for (uint64_t k = n; k < n + n / 2; k++) {
+    if (filter->Add(Key(k)) != cuckoofilter::Ok) {
+      Check(false, name + ": Add");
+      break;
+    }
+  }
+  for (uint64_t k = 0; k < n + n / 2; k++) {
+    const cuckoofilter::Status expected =
+        (k < n && k % 3 == 0) ? cuckoofilter::NotFound : cuckoofilter::Ok;
+    if (filter->ContainExact(Key(k)) != expected) {
+      Check(false, name + ": ContainExact after Delete and Add");
+      break;
+    }
+  }
+}
+
+}  // namespace check
+#endif  // CUCKOO_FILTER_CHECKS_CHECK_H_
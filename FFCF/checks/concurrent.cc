@@ -0,0 +1,145 @@
+// The concurrent mode of CuckooFilterChangeFLength near full load: one
+// writer adds and deletes keys, which kicks entries along cuckoo paths, and
+// changes the fingerprints of others, while readers check that the keys
+// that stay in the filter are found all along. Buckets of 8 and 16-bit
+// tags are 5 and 10 bytes, so their words are not aligned. And CuckooFilter
+// over ConcurrentSingleTable with several writers: every key they added is
+// found afterwards.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "concurrentsingletable.h"
+#include "cuckoofilter.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::ConcurrentSingleTable;
+using cuckoofilter::CuckooFilter;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+const size_t kReaders = 3;
+const size_t kWriters = 4;
+const size_t kWrites = 1 << 18;
+// Key(k) for k from here on is never added
+const uint64_t kQueryKeys = 1ULL << 32;
+
+template <size_t bits_per_tag>
+void CheckKickChains() {
+  typedef CuckooFilterChangeFLength<uint64_t, bits_per_tag,
+                                    SingleTableWithEncode>
+      Filter;
+  const std::string name = std::to_string(bits_per_tag) + "-bit tags";
+  // keys [0, stable) stay; the writer keeps a window of churn keys on top,
+  // which brings the load to 93%
+  const size_t stable = check::kSlots * 0.85;
+  const size_t churn = check::kSlots * 0.08;
+
+  srand(1);
+  Filter filter(check::kSlots * 0.95, 0, TwoIndependentMultiplyShift(1));
+  Check(check::Fill(&filter, Key, stable), name + ": add");
+  Check(filter.SetConcurrent(true) == cuckoofilter::Ok,
+        name + ": SetConcurrent");
+
+  std::atomic<bool> done(false);
+  std::vector<size_t> misses(kReaders, 0);
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < kReaders; t++) {
+    readers.push_back(std::thread([&, t]() {
+      while (!done.load(std::memory_order_acquire)) {
+        for (uint64_t k = t; k < stable; k += kReaders) {
+          misses[t] += (filter.Contain(Key(k)) != cuckoofilter::Ok);
+        }
+      }
+    }));
+  }
+
+  // key stable + c is in the filter for c in [first, next)
+  uint64_t first = 0, next = 0;
+  size_t failures = 0;
+  for (size_t w = 0; w < kWrites; w++) {
+    if (w % 3 == 2) {
+      // the fingerprint of whatever key this one collides with
+      filter.ChangeFingerprint(Key(kQueryKeys + w));
+    } else if (next - first < churn) {
+      failures += (filter.Add(Key(stable + next)) != cuckoofilter::Ok);
+      next++;
+    } else {
+      failures += (filter.Delete(Key(stable + first)) != cuckoofilter::Ok);
+      first++;
+    }
+  }
+  done.store(true, std::memory_order_release);
+  for (size_t t = 0; t < kReaders; t++) {
+    readers[t].join();
+    Check(misses[t] == 0, name + ": keys on reader " + std::to_string(t));
+  }
+
+  Check(failures == 0, name + ": writes");
+  Check(filter.Size() == stable + next - first, name + ": Size");
+  size_t lost = 0;
+  for (uint64_t k = 0; k < stable; k++) {
+    lost += (filter.Contain(Key(k)) != cuckoofilter::Ok);
+  }
+  for (uint64_t c = first; c < next; c++) {
+    lost += (filter.Contain(Key(stable + c)) != cuckoofilter::Ok);
+  }
+  Check(lost == 0, name + ": keys afterwards");
+}
+
+// the writers add interleaved keys up to 90% load, where both buckets of
+// many keys are full and their Add() shifts entries along a cuckoo path
+// while the others claim free slots
+template <size_t bits_per_tag>
+void CheckWriters() {
+  typedef CuckooFilter<uint64_t, bits_per_tag, ConcurrentSingleTable,
+                       TwoIndependentMultiplyShift>
+      Filter;
+  const std::string name =
+      "ConcurrentSingleTable, " + std::to_string(bits_per_tag) + "-bit tags";
+  const size_t n = check::kSlots * 0.9;
+
+  srand(1);
+  Filter filter(check::kSlots * 0.95, 0, TwoIndependentMultiplyShift(1));
+  // added[k] is set if Add(Key(k)) returned Ok
+  std::vector<uint8_t> added(n, 0);
+  std::vector<std::thread> writers;
+  for (size_t t = 0; t < kWriters; t++) {
+    writers.push_back(std::thread([&, t]() {
+      for (uint64_t k = t; k < n; k += kWriters) {
+        added[k] = (filter.Add(Key(k)) == cuckoofilter::Ok);
+      }
+    }));
+  }
+  for (size_t t = 0; t < kWriters; t++) {
+    writers[t].join();
+  }
+
+  size_t adds = 0, lost = 0;
+  for (uint64_t k = 0; k < n; k++) {
+    adds += added[k];
+    lost += (added[k] && filter.Contain(Key(k)) != cuckoofilter::Ok);
+  }
+  Check(adds >= n - n / 100, name + ": Add");
+  Check(filter.Size() == adds, name + ": Size");
+  Check(lost == 0, name + ": " + std::to_string(lost) + " keys added missing");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  CheckKickChains<8>();
+  CheckKickChains<12>();
+  CheckKickChains<16>();
+  CheckWriters<8>();
+  CheckWriters<16>();
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,80 @@
+// ContainBatch() of both filters against Contain() of every key, present
+// or not, on a full table with a victim and in the middle of a grow.
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilter.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::CuckooFilter;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// ContainBatch() of the keys from key(0) on, of which the first n are in
+// the filter and the rest mostly not, in one batch that is no multiple of
+// the window
+template <typename Filter>
+void CheckBatch(const Filter &filter, const size_t n,
+                const std::string &name) {
+  std::vector<uint64_t> keys;
+  for (uint64_t k = 0; k < n + check::kQueries + 3; k++) {
+    keys.push_back(Key(k));
+  }
+  std::vector<uint8_t> out(keys.size());
+  filter.ContainBatch(keys.data(), keys.size(), out.data());
+  size_t mismatches = 0, found = 0;
+  for (size_t k = 0; k < keys.size(); k++) {
+    mismatches += (out[k] != filter.Contain(keys[k]));
+    found += (out[k] == cuckoofilter::Ok);
+  }
+  Check(mismatches == 0, name + ": ContainBatch == Contain");
+  Check(found >= n && found < keys.size(), name + ": hits");
+}
+
+// Add() until the filter refuses one, leaving a victim
+template <typename Filter>
+size_t FillUp(Filter *filter) {
+  size_t added = 0;
+  while (filter->Add(Key(added)) == cuckoofilter::Ok) {
+    added++;
+  }
+  return added;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilter<uint64_t, 12, cuckoofilter::SingleTable,
+                       TwoIndependentMultiplyShift>
+      PlainFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const size_t n = check::kSlots * 0.95;
+
+  srand(1);
+  PlainFilter plain(n, 0, TwoIndependentMultiplyShift(1));
+  CheckBatch(plain, FillUp(&plain), "CuckooFilter");
+
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  CheckBatch(filter, FillUp(&filter), "CuckooFilterChangeFLength");
+
+  srand(1);
+  Filter growing(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&growing, Key, n);
+  growing.StartGrow();
+  growing.MigrateBuckets(check::kSlots / 16);
+  CheckBatch(growing, n, "CuckooFilterChangeFLength growing");
+
+  // readers of a concurrent filter take another path
+  filter.SetConcurrent(true);
+  CheckBatch(filter, n, "CuckooFilterChangeFLength concurrent");
+  return check::Done(argv[0]);
+}
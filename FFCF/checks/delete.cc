@@ -0,0 +1,92 @@
+// Delete() from full buckets, whose short fields hold half a tag each: a
+// key that was never added must not delete the entry of another key that
+// shares one half of its tag, which would then go missing. With keys in
+// the item store, not even one that shares the whole tag, and a Delete()
+// of a key takes its own entry, not that of a key with the same tag.
+
+#include <string>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::FindsAll;
+using check::Key;
+using check::MapSource;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::SingleTableWithSource;
+using cuckoofilter::SingleTableWithTags;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// Delete() of kQueries keys that were never added to a filter at 95% load
+template <typename Filter>
+void CheckFalseDeletes(const std::string &name,
+                       const typename Filter::StoreOptions &options) {
+  const size_t n = check::kSlots * 0.95;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1), options);
+  check::Fill(&filter, Key, n);
+  size_t deleted = 0;
+  for (uint64_t k = n; k < n + check::kQueries; k++) {
+    deleted += (filter.Delete(Key(k)) == cuckoofilter::Ok);
+  }
+  Check(deleted == 0, name + ": " + std::to_string(deleted) +
+                          " keys never added deleted");
+  Check(filter.Size() == n, name + ": Size");
+  size_t found = 0;
+  for (uint64_t k = 0; k < n; k++) {
+    found += (filter.Contain(Key(k)) == cuckoofilter::Ok);
+  }
+  Check(found == n, name + ": " + std::to_string(n - found) +
+                        " keys added missing");
+}
+
+// keys [0, stable) stay in a filter of 8-bit tags, whose whole tags of 16
+// bits meet often, while a window of other keys is added and deleted;
+// every key left is then found exactly, also after a Grow() that moves the
+// entries by their items
+template <typename Filter>
+void CheckChurn(const std::string &name) {
+  const size_t stable = check::kSlots * 0.85;
+  const size_t churn = check::kSlots * 0.08;
+  srand(1);
+  Filter filter(check::kSlots * 0.95, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&filter, Key, stable);
+  uint64_t first = 0, next = 0;
+  for (size_t w = 0; w < (1 << 17); w++) {
+    if (next - first < churn) {
+      filter.Add(Key(stable + next++));
+    } else if (filter.Delete(Key(stable + first++)) != cuckoofilter::Ok) {
+      Check(false, name + ": Delete");
+      break;
+    }
+  }
+  Check(FindsAll(filter, Key, stable, true), name + ": keys after churn");
+  Check(filter.Grow() == cuckoofilter::Ok, name + ": Grow");
+  Check(FindsAll(filter, Key, stable, true), name + ": keys after Grow");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      KeyFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithTags>
+      TagFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12,
+                                    SingleTableWithSource<MapSource>::Table>
+      SourceFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 8, SingleTableWithEncode>
+      ShortTagFilter;
+  CheckFalseDeletes<KeyFilter>("KeyStore", KeyFilter::StoreOptions());
+  CheckFalseDeletes<ShortTagFilter>("KeyStore, 8-bit tags",
+                                    ShortTagFilter::StoreOptions());
+  CheckChurn<ShortTagFilter>("KeyStore, 8-bit tags");
+  CheckFalseDeletes<TagFilter>("TagStore", TagFilter::StoreOptions());
+  MapSource source;
+  CheckFalseDeletes<SourceFilter>("CallbackStore", &source);
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,87 @@
+// FileStore I/O errors: a store whose file cannot be created, or written
+// once the file size limit is hit, reports Failed(), after which the calls
+// of the filter that use the items return NotSupported while Contain()
+// keeps answering from the tags.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <sstream>
+#include <string>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithFile;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithFile<>::Table>
+    Filter;
+
+// more buckets than the cache of the store holds, so that blocks are
+// written back while the filter fills
+const size_t kFileSlots = 1 << 18;
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t n = kFileSlots * 0.95;
+  // a write past the limit fails with EFBIG instead of killing the process
+  signal(SIGXFSZ, SIG_IGN);
+
+  {
+    const char *tmpdir = getenv("TMPDIR");
+    const std::string saved = tmpdir != NULL ? tmpdir : "";
+    setenv("TMPDIR", "/nonexistent", 1);
+    Filter filter(1024, 0, TwoIndependentMultiplyShift(1));
+    if (tmpdir != NULL) {
+      setenv("TMPDIR", saved.c_str(), 1);
+    } else {
+      unsetenv("TMPDIR");
+    }
+    Check(filter.StoreFailed(), "no file: Failed");
+    Check(filter.Add(Key(0)) == cuckoofilter::NotSupported, "no file: Add");
+  }
+
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  check::Fill(&filter, Key, n / 2);
+  Check(!filter.StoreFailed(), "not Failed before an error");
+
+  struct rlimit limit;
+  getrlimit(RLIMIT_FSIZE, &limit);
+  const rlim_t saved = limit.rlim_cur;
+  limit.rlim_cur = 4096;
+  setrlimit(RLIMIT_FSIZE, &limit);
+  uint64_t k = n / 2;
+  cuckoofilter::Status status = cuckoofilter::Ok;
+  while (k < n && (status = filter.Add(Key(k))) == cuckoofilter::Ok) {
+    k++;
+  }
+  limit.rlim_cur = saved;
+  setrlimit(RLIMIT_FSIZE, &limit);
+
+  Check(filter.StoreFailed(), "Failed after a write error");
+  Check(status == cuckoofilter::NotSupported, "Add after a write error");
+  Check(filter.ContainExact(Key(0)) == cuckoofilter::NotSupported,
+        "ContainExact after a write error");
+  Check(filter.Delete(Key(0)) == cuckoofilter::NotSupported,
+        "Delete after a write error");
+  std::stringstream out;
+  Check(filter.Serialize(out) == cuckoofilter::NotSupported,
+        "Serialize after a write error");
+  Check(filter.Serialize(out, false) == cuckoofilter::Ok,
+        "Serialize without items after a write error");
+  size_t misses = 0;
+  for (uint64_t key = 0; key < n / 2; key++) {
+    misses += (filter.Contain(Key(key)) != cuckoofilter::Ok);
+  }
+  Check(misses == 0, "Contain after a write error");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,52 @@
+// Grow() of CuckooFilterChangeFLength, called directly, once the table is
+// full and by auto-grow: the keys stay, and Add/Delete keep working.
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Fill;
+using check::FindsAll;
+using check::Key;
+using check::Mutate;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const size_t n = check::kSlots * 0.9;
+
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  Check(Fill(&filter, Key, n), "Grow: add");
+  const size_t bytes = filter.SizeInBytes();
+  Check(filter.Grow() == cuckoofilter::Ok, "Grow");
+  Check(filter.SizeInBytes() > bytes, "Grow: more buckets");
+  Check(filter.Size() == n, "Grow: Size");
+  Check(FindsAll(filter, Key, n, true), "Grow: keys");
+  Mutate(&filter, n, "Grow");
+
+  // the victim of the last Add() before a full table refused one goes into
+  // the grown table
+  srand(1);
+  Filter full(n, 0, TwoIndependentMultiplyShift(1));
+  uint64_t added = 0;
+  while (full.Add(Key(added)) == cuckoofilter::Ok) {
+    added++;
+  }
+  Check(full.Grow() == cuckoofilter::Ok, "Grow when full");
+  Check(FindsAll(full, Key, added, true), "Grow when full: keys");
+  Check(full.Add(Key(added)) == cuckoofilter::Ok,
+        "Grow when full: Add");
+
+  // auto-grow from a table of a few buckets
+  srand(1);
+  Filter automatic(1024, 0, TwoIndependentMultiplyShift(1));
+  automatic.SetAutoGrow(0.9);
+  Check(Fill(&automatic, Key, n), "auto-grow: add");
+  Check(automatic.Size() == n, "auto-grow: Size");
+  Check(FindsAll(automatic, Key, n, true), "auto-grow: keys");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,115 @@
+// Incremental growth of CuckooFilterChangeFLength: StartGrow() and a few
+// buckets moved per mutation, with the old table read alongside the new one
+// until every bucket moved, also once the new table fills up. Growing with
+// no memory for the new table fails and leaves the filter as it was.
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include <sstream>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Fill;
+using check::FindsAll;
+using check::Key;
+using check::Mutate;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// the address space the process takes now, from /proc/self/statm
+size_t AddressSpace() {
+  size_t pages = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != NULL) {
+    if (fscanf(statm, "%zu", &pages) != 1) {
+      pages = 0;
+    }
+    fclose(statm);
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const size_t n = check::kSlots * 0.9;
+
+  // the old table is read alongside the new one until every bucket moved
+  srand(1);
+  Filter incremental(n, 0, TwoIndependentMultiplyShift(1));
+  Fill(&incremental, Key, n);
+  Check(incremental.StartGrow() == cuckoofilter::Ok, "StartGrow");
+  Check(incremental.Growing(), "StartGrow: Growing");
+  incremental.MigrateBuckets(check::kSlots / 64);
+  Check(FindsAll(incremental, Key, n, true), "StartGrow: keys midway");
+  std::stringstream buffer;
+  Check(incremental.Serialize(buffer) == cuckoofilter::NotSupported,
+        "StartGrow: Serialize midway");
+  Mutate(&incremental, n, "StartGrow");
+  while (incremental.MigrateBuckets(64) > 0) {
+  }
+  Check(!incremental.Growing(), "StartGrow: finished");
+  Check(incremental.Size() == n - (n + 2) / 3 + n / 2, "StartGrow: Size");
+
+  // without auto-grow the new table fills up before the buckets are moved;
+  // a victim then stops every bucket, so the rest moves in one go
+  srand(1);
+  Filter stalled(n, 0, TwoIndependentMultiplyShift(1));
+  Fill(&stalled, Key, n);
+  stalled.StartGrow();
+  uint64_t added = n;
+  while (stalled.Add(Key(added)) == cuckoofilter::Ok) {
+    added++;
+  }
+  Check(added > 2 * n, "victim: new table full");
+  for (size_t k = 0; k <= check::kSlots / 4 && stalled.Growing(); k++) {
+    stalled.MigrateBuckets(64);
+  }
+  Check(!stalled.Growing(), "victim: finished");
+  Check(stalled.Size() == added, "victim: Size");
+  Check(FindsAll(stalled, Key, added, true), "victim: keys");
+  Check(stalled.Add(Key(added)) == cuckoofilter::Ok, "victim: Add");
+
+  // auto-grow moving a few buckets on every mutation
+  srand(1);
+  Filter automatic(1024, 0, TwoIndependentMultiplyShift(1));
+  automatic.SetAutoGrow(0.9);
+  automatic.SetIncrementalGrow(8);
+  Check(Fill(&automatic, Key, n), "auto-grow: add");
+  Check(automatic.Size() == n, "auto-grow: Size");
+  Check(FindsAll(automatic, Key, n, true), "auto-grow: keys");
+
+  // a table of 2^20 slots and 8 MB of keys, with 4 MB of address space left
+  const size_t big_n = (check::kSlots << 6) * 0.9;
+  srand(1);
+  Filter big(big_n, 0, TwoIndependentMultiplyShift(1));
+  Fill(&big, Key, big_n);
+  Filter copy(1, 0, TwoIndependentMultiplyShift(1));
+  std::stringstream serialized;
+  big.Serialize(serialized);
+  struct rlimit limit;
+  getrlimit(RLIMIT_AS, &limit);
+  const rlim_t unlimited = limit.rlim_cur;
+  limit.rlim_cur = AddressSpace() + (4 << 20);
+  setrlimit(RLIMIT_AS, &limit);
+  Check(big.Grow() == cuckoofilter::NotEnoughSpace, "no memory: Grow");
+  Check(big.StartGrow() == cuckoofilter::NotEnoughSpace,
+        "no memory: StartGrow");
+  Check(copy.Deserialize(serialized) == cuckoofilter::NotEnoughSpace,
+        "no memory: Deserialize");
+  limit.rlim_cur = unlimited;
+  setrlimit(RLIMIT_AS, &limit);
+  Check(!big.Growing() && big.Size() == big_n, "no memory: unchanged");
+  Check(FindsAll(big, Key, big_n, true), "no memory: keys");
+  Check(big.Grow() == cuckoofilter::Ok, "no memory: Grow later");
+  Check(copy.Size() == 0, "no memory: Deserialize unchanged");
+  return check::Done(argv[0]);
+}
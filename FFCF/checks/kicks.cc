@@ -0,0 +1,93 @@
+// Cuckoo kicks of CuckooFilterChangeFLength, which move an entry by the
+// bits kept in its bucket instead of hashing its item again, with each item
+// store and insert mode.
+
+#include <string>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Fill;
+using check::FindsAll;
+using check::Key;
+using check::MapSource;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::SingleTableWithSource;
+using cuckoofilter::SingleTableWithTags;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// TwoIndependentMultiplyShift that counts its calls
+size_t hash_calls = 0;
+
+struct CountingHash {
+  TwoIndependentMultiplyShift hash;
+
+  CountingHash() : hash(1) {}
+  uint64_t operator()(uint64_t key) const {
+    hash_calls++;
+    return hash(key);
+  }
+};
+
+// kicks move an entry by the bits kept in its bucket: the hasher runs once
+// per Add() with a tag store, and a store of keys hashes the item of a
+// kicked entry only where it needs its whole tag, so a random walk hashes
+// less than once per kick. source, if not NULL, is the store of the filter
+// and counts the entries moved.
+template <typename Filter>
+void CheckKicks(const std::string &name, const cuckoofilter::InsertMode mode,
+                const typename Filter::StoreOptions &options,
+                const MapSource *source) {
+  const size_t n = check::kSlots * 0.95;
+  srand(1);
+  Filter filter(n, 0, CountingHash(), options);
+  filter.SetInsertMode(mode);
+  hash_calls = 0;
+  Check(Fill(&filter, Key, n), name + ": add");
+  if (!filter.HasKeys()) {
+    Check(hash_calls == n, name + ": one hash per Add");
+  } else if (source != NULL && mode == cuckoofilter::RandomWalk) {
+    // every Add() stores its item once and once more per kick
+    Check(hash_calls - n < source->stores - n, name + ": hashes per kick");
+  }
+  Check(FindsAll(filter, Key, n, filter.HasKeys()), name + ": keys");
+  for (uint64_t k = 0; k < n; k += 2) {
+    if (filter.Delete(Key(k)) != cuckoofilter::Ok) {
+      Check(false, name + ": Delete after kicks");
+      break;
+    }
+  }
+  Check(FindsAll(filter, [](uint64_t k) { return Key(2 * k + 1); }, n / 2,
+                 filter.HasKeys()),
+        name + ": keys after Delete");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithTags,
+                                    CountingHash>
+      TagFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode,
+                                    CountingHash>
+      KeyFilter;
+  typedef CuckooFilterChangeFLength<
+      uint64_t, 12, SingleTableWithSource<MapSource>::Table, CountingHash>
+      SourceFilter;
+  CheckKicks<TagFilter>("TagStore RandomWalk", cuckoofilter::RandomWalk,
+                        TagFilter::StoreOptions(), NULL);
+  CheckKicks<TagFilter>("TagStore PathSearch", cuckoofilter::PathSearch,
+                        TagFilter::StoreOptions(), NULL);
+  CheckKicks<KeyFilter>("KeyStore RandomWalk", cuckoofilter::RandomWalk,
+                        KeyFilter::StoreOptions(), NULL);
+  CheckKicks<KeyFilter>("KeyStore PathSearch", cuckoofilter::PathSearch,
+                        KeyFilter::StoreOptions(), NULL);
+  MapSource source;
+  CheckKicks<SourceFilter>("CallbackStore RandomWalk",
+                           cuckoofilter::RandomWalk, &source, &source);
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,63 @@
+// Map() of a serialized CuckooFilterChangeFLength, with and without its
+// items: a read-only view that answers as the filter did.
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::FalsePositives;
+using check::Fill;
+using check::FindsAll;
+using check::Key;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const size_t n = check::kSlots * 0.95;
+  const std::string path = check::TempPath();
+  Check(!path.empty(), "Map: temporary file");
+  if (path.empty()) {
+    return check::Done(argv[0]);
+  }
+
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+  Fill(&filter, Key, n);
+  for (int with_items = 0; with_items <= 1; with_items++) {
+    const std::string name =
+        with_items ? "Map with items" : "Map without items";
+    {
+      std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+      Check(filter.Serialize(out, with_items) == cuckoofilter::Ok,
+            name + ": Serialize");
+    }
+    Filter view(16, 0, TwoIndependentMultiplyShift(1));
+    Check(view.Map(path.c_str(), with_items, true) == cuckoofilter::Ok,
+          name + ": Map");
+    Check(view.ReadOnly(), name + ": ReadOnly");
+    Check(view.Size() == filter.Size(), name + ": Size");
+    Check(FindsAll(view, Key, n, false), name + ": keys");
+    Check(FalsePositives(view, Key, n) == FalsePositives(filter, Key, n),
+          name + ": false positives");
+    Check(view.Add(Key(n)) == cuckoofilter::NotSupported, name + ": Add");
+    Check(view.Delete(Key(0)) == cuckoofilter::NotSupported,
+          name + ": Delete");
+    std::vector<uint64_t> items;
+    view.ExportItems(&items);
+    Check(with_items ? items.size() == filter.Size() : items.size() <= 1,
+          name + ": ExportItems");
+  }
+
+  Filter view(16, 0, TwoIndependentMultiplyShift(1));
+  Check(view.Map("/nonexistent/filter") == cuckoofilter::InvalidFormat,
+        "Map of a missing file");
+  unlink(path.c_str());
+  return check::Done(argv[0]);
+}
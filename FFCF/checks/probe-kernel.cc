@@ -0,0 +1,86 @@
+// The lookup kernels of SingleTableWithEncode over every pair of bucket
+// occupancies: FindTagInBucketsScalar() finds every tag that was put in,
+// and FindTagInBucketsByOccupancy() and FindTagInBucketsAVX2(), when built
+// with -mavx2, answer as it does for those tags, tags that share a half
+// with one of them and others.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "singletablewithencode.h"
+
+using check::Check;
+using cuckoofilter::SingleTableWithEncode;
+
+namespace {
+
+const size_t kRounds = 64;
+
+// queries around the tags in the buckets: each tag, the tag with either
+// half replaced, and a random one
+template <size_t bits_per_tag>
+std::vector<uint32_t> Queries(const std::vector<uint32_t> &tags,
+                              std::mt19937_64 *rng) {
+  const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+  std::vector<uint32_t> queries;
+  for (size_t k = 0; k < tags.size(); k++) {
+    const uint32_t low = tags[k] & kTagMask;
+    const uint32_t high = tags[k] & (kTagMask << bits_per_tag);
+    queries.push_back(tags[k]);
+    queries.push_back(low | ((*rng)() & (kTagMask << bits_per_tag)));
+    queries.push_back(high | ((*rng)() & kTagMask));
+    queries.push_back(high);
+  }
+  queries.push_back(((*rng)() & ((1ULL << (2 * bits_per_tag)) - 1)) | 1);
+  return queries;
+}
+
+template <size_t bits_per_tag>
+void CheckKernels() {
+  typedef SingleTableWithEncode<bits_per_tag> Table;
+  const std::string name = std::to_string(bits_per_tag) + "-bit tags";
+  std::mt19937_64 rng(bits_per_tag);
+  size_t misses = 0, mismatches = 0;
+  for (size_t a1 = 0; a1 <= 4; a1++) {
+    for (size_t a2 = 0; a2 <= 4; a2++) {
+      for (size_t r = 0; r < kRounds; r++) {
+        Table table(2);
+        std::vector<uint32_t> tags;
+        uint32_t oldtag;
+        uint64_t olditem;
+        for (size_t k = 0; k < a1 + a2; k++) {
+          uint32_t tag = rng() & ((1ULL << (2 * bits_per_tag)) - 1);
+          tag += (tag == 0);
+          table.InsertTagToBucket(k < a1 ? 0 : 1, tag, false, oldtag, rng(),
+                                  olditem);
+          tags.push_back(tag);
+        }
+        const std::vector<uint32_t> queries =
+            Queries<bits_per_tag>(tags, &rng);
+        for (size_t q = 0; q < queries.size(); q++) {
+          const bool scalar = table.FindTagInBucketsScalar(0, 1, queries[q]);
+          misses += (q < 4 * tags.size() && q % 4 == 0 && !scalar);
+          mismatches += (table.FindTagInBucketsByOccupancy(
+                             0, 1, queries[q]) != scalar);
+#if defined(__AVX2__)
+          mismatches +=
+              (table.FindTagInBucketsAVX2(0, 1, queries[q]) != scalar);
+#endif
+        }
+      }
+    }
+  }
+  Check(misses == 0, name + ": scalar finds every tag");
+  Check(mismatches == 0, name + ": occupancy and avx2 == scalar");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  CheckKernels<8>();
+  CheckKernels<12>();
+  CheckKernels<16>();
+  return check::Done(argv[0]);
+}
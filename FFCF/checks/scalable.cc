@@ -0,0 +1,70 @@
+// ScalableCuckooFilter over several generations: keys added across the
+// growth steps stay found and deletable, Compact() keeps them, and each
+// generation of a CallbackStore filter keeps its items in a Source of its
+// own.
+
+#include <deque>
+#include <string>
+
+#include "check.h"
+#include "scalablecuckoofilter.h"
+
+using check::Check;
+using check::FindsAll;
+using check::Key;
+using check::MapSource;
+using cuckoofilter::ScalableCuckooFilter;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::SingleTableWithSource;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+int main(int argc, char **argv) {
+  typedef ScalableCuckooFilter<uint64_t, 12, SingleTableWithEncode> Filter;
+  typedef ScalableCuckooFilter<uint64_t, 12,
+                               SingleTableWithSource<MapSource>::Table>
+      SourceFilter;
+  const size_t n = check::kSlots * 4;
+
+  srand(1);
+  Filter filter(1024, 2, 0.9, TwoIndependentMultiplyShift(1));
+  Check(check::Fill(&filter, Key, n), "add");
+  Check(filter.NumGenerations() > 2, "generations");
+  Check(filter.Size() == n, "Size");
+  Check(FindsAll(filter, Key, n, true), "keys");
+  for (uint64_t k = 0; k < n; k += 2) {
+    if (filter.Delete(Key(k)) != cuckoofilter::Ok) {
+      Check(false, "Delete");
+      break;
+    }
+  }
+  Check(FindsAll(filter, [](uint64_t k) { return Key(2 * k + 1); }, n / 2,
+                 true),
+        "keys after Delete");
+  Check(filter.Compact() == cuckoofilter::Ok, "Compact");
+  Check(filter.NumGenerations() == 1, "Compact: one generation");
+  Check(FindsAll(filter, [](uint64_t k) { return Key(2 * k + 1); }, n / 2,
+                 true),
+        "keys after Compact");
+
+  // a Source per generation, which a deque keeps in place as it grows
+  std::deque<MapSource> sources;
+  srand(1);
+  SourceFilter callback(1024, 2, 0.9, TwoIndependentMultiplyShift(1),
+                        [&sources](size_t g) {
+                          while (sources.size() <= g) {
+                            sources.emplace_back();
+                          }
+                          return &sources[g];
+                        });
+  Check(check::Fill(&callback, Key, n), "CallbackStore: add");
+  Check(callback.NumGenerations() == sources.size(),
+        "CallbackStore: a Source per generation");
+  size_t stored = 0;
+  for (size_t g = 0; g < callback.NumGenerations(); g++) {
+    stored += (sources[g].keys.size() == callback.Stats(g).num_items);
+  }
+  Check(stored == callback.NumGenerations(),
+        "CallbackStore: the items of each generation in its Source");
+  Check(FindsAll(callback, Key, n, true), "CallbackStore: keys");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,67 @@
+// Seeded hash families: filters built alike with one seed serialize to the
+// same bytes and have the same false positives, with another seed or the
+// random default they have other ones, for each HashFamily in hashutil.h.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+
+namespace {
+
+// a filter with n keys hashed by hasher: its bytes, and which of kQueries
+// other keys it reports
+struct Built {
+  std::string bytes;
+  std::vector<bool> hits;
+};
+
+template <typename HashFamily>
+Built Build(const HashFamily &hasher) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode,
+                                    HashFamily>
+      Filter;
+  const size_t n = check::kSlots * 0.9;
+  srand(1);
+  Filter filter(n, 0, hasher);
+  check::Fill(&filter, Key, n);
+  std::stringstream out;
+  filter.Serialize(out);
+  Built built;
+  built.bytes = out.str();
+  for (uint64_t k = n; k < n + check::kQueries; k++) {
+    built.hits.push_back(filter.Contain(Key(k)) == cuckoofilter::Ok);
+  }
+  return built;
+}
+
+template <typename HashFamily>
+void CheckSeeds(const std::string &name) {
+  const Built seeded = Build(HashFamily(7));
+  const Built same = Build(HashFamily(7));
+  Check(!seeded.bytes.empty(), name + ": Serialize");
+  Check(same.bytes == seeded.bytes && same.hits == seeded.hits,
+        name + ": same seed, same filter");
+  Check(Build(HashFamily(8)).hits != seeded.hits,
+        name + ": another seed, other false positives");
+  Check(Build(HashFamily()).hits != Build(HashFamily()).hits,
+        name + ": random seeds, other false positives");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  CheckSeeds<cuckoofilter::TwoIndependentMultiplyShift>(
+      "TwoIndependentMultiplyShift");
+  CheckSeeds<cuckoofilter::SimpleTabulation>("SimpleTabulation");
+  CheckSeeds<cuckoofilter::WyHashFamily>("WyHashFamily");
+  CheckSeeds<cuckoofilter::Crc32cHashFamily>("Crc32cHashFamily");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,142 @@
+// Serialize()/Deserialize() round-trips of CuckooFilterChangeFLength with
+// every item store, and streams that Deserialize() refuses.
+
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::FalsePositives;
+using check::Fill;
+using check::FindsAll;
+using check::Key;
+using check::MapSource;
+using check::ShortKey;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::SingleTableWithFile;
+using cuckoofilter::SingleTableWithKeys;
+using cuckoofilter::SingleTableWithSource;
+using cuckoofilter::SingleTableWithTags;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// Serialize() a filter at 95% load and Deserialize() it into one of another
+// size: same items, same answers, same false positives
+template <typename Filter>
+void CheckRoundTrip(const std::string &name, uint64_t (*key)(uint64_t),
+                    const typename Filter::StoreOptions &from,
+                    const typename Filter::StoreOptions &to) {
+  const size_t n = check::kSlots * 0.95;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1), from);
+  Check(Fill(&filter, key, n), name + ": add");
+
+  std::stringstream buffer;
+  Check(filter.Serialize(buffer) == cuckoofilter::Ok, name + ": Serialize");
+  Filter copy(16, 0, TwoIndependentMultiplyShift(1), to);
+  Check(copy.Deserialize(buffer) == cuckoofilter::Ok, name + ": Deserialize");
+  Check(copy.Size() == filter.Size(), name + ": Size after Deserialize");
+  Check(FindsAll(copy, key, n, copy.HasKeys()),
+        name + ": keys after Deserialize");
+  Check(FalsePositives(copy, key, n) == FalsePositives(filter, key, n),
+        name + ": false positives after Deserialize");
+  if (copy.HasKeys()) {
+    std::vector<uint64_t> items, copied;
+    filter.ExportItems(&items);
+    copy.ExportItems(&copied);
+    std::sort(items.begin(), items.end());
+    std::sort(copied.begin(), copied.end());
+    Check(items == copied, name + ": items after Deserialize");
+  }
+
+  // the rest of the stream is not a filter
+  std::stringstream garbage("not a filter");
+  Check(copy.Deserialize(garbage) == cuckoofilter::InvalidFormat,
+        name + ": Deserialize of garbage");
+  Check(copy.Size() == filter.Size(), name + ": unchanged after garbage");
+}
+
+// stream, written by Serialize(), as if by a filter of format version:
+// the header says so and every checksum matches again
+std::string WithVersion(const std::string &stream, const uint32_t version,
+                        const size_t hasher_size) {
+  std::string out = stream;
+  cuckoofilter::FilterHeader header;
+  memcpy(&header, out.data(), sizeof(header));
+  header.version = version;
+  memcpy(&out[0], &header, sizeof(header));
+  const size_t sections[3] = {sizeof(header) + hasher_size,
+                              header.num_buckets * header.bucket_bytes,
+                              header.num_buckets * header.item_bucket_bytes};
+  uint32_t checksum = 0;
+  size_t pos = 0;
+  for (size_t s = 0; s < 3; s++) {
+    checksum = cuckoofilter::HashUtil::MurmurHash(out.data() + pos,
+                                                  sections[s], checksum);
+    memcpy(&out[pos + sections[s]], &checksum, sizeof(checksum));
+    pos += sections[s] + sizeof(checksum);
+  }
+  return out;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      EncodeFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithTags>
+      TagFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12,
+                                    SingleTableWithKeys<32>::Table>
+      KeyFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12,
+                                    SingleTableWithFile<>::Table>
+      FileFilter;
+  typedef CuckooFilterChangeFLength<uint64_t, 12,
+                                    SingleTableWithSource<MapSource>::Table>
+      SourceFilter;
+
+  CheckRoundTrip<EncodeFilter>("KeyStore", Key, EncodeFilter::StoreOptions(),
+                               EncodeFilter::StoreOptions());
+  CheckRoundTrip<TagFilter>("TagStore", Key, TagFilter::StoreOptions(),
+                            TagFilter::StoreOptions());
+  CheckRoundTrip<KeyFilter>("KeyStore<32>", ShortKey,
+                            KeyFilter::StoreOptions(),
+                            KeyFilter::StoreOptions());
+  CheckRoundTrip<FileFilter>("FileStore", Key, FileFilter::StoreOptions(),
+                             FileFilter::StoreOptions());
+  // the keys stay in the source, which the copy reads as well
+  MapSource source;
+  CheckRoundTrip<SourceFilter>("CallbackStore", Key, &source, &source);
+
+  // a filter of other template parameters is not read
+  std::stringstream buffer;
+  EncodeFilter filter(check::kSlots, 0, TwoIndependentMultiplyShift(1));
+  Fill(&filter, Key, 100);
+  filter.Serialize(buffer);
+  TagFilter other(16, 0, TwoIndependentMultiplyShift(1));
+  Check(other.Deserialize(buffer) == cuckoofilter::InvalidFormat,
+        "Deserialize of another table type");
+
+  // a filter of an older format, whose alternate buckets or hashes differ,
+  // is not read either
+  const std::string current = buffer.str();
+  const size_t hasher_size = sizeof(TwoIndependentMultiplyShift);
+  for (uint32_t version = 2; version <= cuckoofilter::kFilterFormatVersion;
+       version++) {
+    std::stringstream old(WithVersion(current, version, hasher_size));
+    EncodeFilter copy(16, 0, TwoIndependentMultiplyShift(1));
+    const bool read = copy.Deserialize(old) == cuckoofilter::Ok;
+    Check(read == (version == cuckoofilter::kFilterFormatVersion),
+          "Deserialize of format version " + std::to_string(version));
+  }
+  return check::Done(argv[0]);
+}
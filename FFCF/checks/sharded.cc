@@ -0,0 +1,102 @@
+// ShardedCuckooFilter over CuckooFilterChangeFLength: keys added from
+// several threads are all found, spread over the shards, and stay found
+// across Delete() of others and a Grow() of one shard.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+#include "shardedcuckoofilter.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::ShardedCuckooFilter;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+const size_t kShards = 8;
+const size_t kThreads = 4;
+
+typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+    ShardFilter;
+typedef ShardedCuckooFilter<ShardFilter, kShards> Filter;
+
+// the keys of [from, to) answered wrongly: all of them must be found, but
+// every third one not if deleted
+size_t Misses(const Filter &filter, const uint64_t from, const uint64_t to,
+              const bool deleted) {
+  size_t misses = 0;
+  for (uint64_t k = from; k < to; k++) {
+    if (deleted && k % 3 == 0) {
+      misses += (filter.ContainExact(Key(k)) != cuckoofilter::NotFound);
+    } else {
+      misses += (filter.Contain(Key(k)) != cuckoofilter::Ok ||
+                 filter.ContainExact(Key(k)) != cuckoofilter::Ok);
+    }
+  }
+  return misses;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t n = check::kSlots * 4 * 0.9;
+  srand(1);
+  Filter filter(n, 0, TwoIndependentMultiplyShift(1));
+
+  // each thread adds its share of the keys, then checks all of them
+  std::vector<size_t> failures(kThreads), misses(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (uint64_t k = t; k < n; k += kThreads) {
+        failures[t] += (filter.Add(Key(k)) != cuckoofilter::Ok);
+      }
+    }));
+  }
+  for (size_t t = 0; t < kThreads; t++) {
+    threads[t].join();
+  }
+  threads.clear();
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      misses[t] = Misses(filter, t * n / kThreads, (t + 1) * n / kThreads,
+                         false);
+    }));
+  }
+  for (size_t t = 0; t < kThreads; t++) {
+    threads[t].join();
+    Check(failures[t] == 0, "Add on thread " + std::to_string(t));
+    Check(misses[t] == 0, "keys on thread " + std::to_string(t));
+  }
+  Check(filter.Size() == n, "Size");
+
+  // the top bits of the hash spread the keys evenly
+  for (size_t s = 0; s < kShards; s++) {
+    size_t size = 0;
+    filter.WithShard(s, [&](ShardFilter &shard) { size = shard.Size(); });
+    Check(size > n / kShards * 0.9 && size < n / kShards * 1.1,
+          "keys of shard " + std::to_string(s));
+  }
+
+  for (uint64_t k = 0; k < n; k += 3) {
+    if (filter.Delete(Key(k)) != cuckoofilter::Ok) {
+      Check(false, "Delete");
+      break;
+    }
+  }
+  Check(Misses(filter, 0, n, true) == 0, "keys after Delete");
+  Check(filter.Size() == n - (n + 2) / 3, "Size after Delete");
+
+  // the other shards keep their keys while one grows
+  filter.WithShard(kShards - 1, [](ShardFilter &shard) {
+    Check(shard.Grow() == cuckoofilter::Ok, "Grow of a shard");
+  });
+  Check(Misses(filter, 0, n, true) == 0, "keys after Grow of a shard");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,82 @@
+// The table size of both filters from max_num_keys and bits_per_key: the
+// table holds max_num_keys unless the budget cut it, which Capacity() then
+// shows, and the ctor prints nothing.
+
+#include <sstream>
+
+#include "check.h"
+#include "cuckoofilter.h"
+#include "cuckoofilterchange.h"
+
+using check::Check;
+using check::Key;
+using cuckoofilter::CuckooFilter;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// Add() of the keys from Key(0) on until the first refusal, at most 2 *
+// capacity: the number taken if all of them are found afterwards, else 0
+template <typename Filter>
+size_t AddAll(Filter *filter, const size_t capacity) {
+  uint64_t added = 0;
+  while (added < 2 * capacity && filter->Add(Key(added)) == cuckoofilter::Ok) {
+    added++;
+  }
+  for (uint64_t k = 0; k < added; k++) {
+    if (filter->Contain(Key(k)) != cuckoofilter::Ok) {
+      return 0;
+    }
+  }
+  return added;
+}
+
+// the filter takes about Capacity() keys and refuses more
+bool FillsCapacity(const size_t added, const size_t capacity) {
+  return added >= 0.9 * capacity && added < 2 * capacity;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithEncode>
+      Filter;
+  const size_t n = check::kSlots * 0.95;
+
+  std::stringstream out;
+  std::streambuf *const stdout_buf = std::cout.rdbuf(out.rdbuf());
+  Filter fits(n, 0, TwoIndependentMultiplyShift(1));
+  // 80 bits a key fill a table with 64-bit keys at load 1, not at 0.95
+  Filter cut(n, 80, TwoIndependentMultiplyShift(1));
+  std::cout.rdbuf(stdout_buf);
+  Check(out.str().empty(), "ctor prints nothing");
+
+  Check(fits.Capacity() >= n && fits.Capacity() < 2 * n, "Capacity()");
+  Check(fits.SizeInBytes() * 8 <= 2 * 80 * n, "smallest table");
+  Check(FillsCapacity(AddAll(&fits, fits.Capacity()), fits.Capacity()),
+        "Add up to Capacity()");
+
+  Check(cut.Capacity() < n, "budget: Capacity() < max_num_keys");
+  Check(cut.SizeInBytes() * 8 <= 80 * n, "budget: table within it");
+  Check(FillsCapacity(AddAll(&cut, cut.Capacity()), cut.Capacity()),
+        "budget: Add up to Capacity()");
+
+  // 8 bits a key with 12-bit tags; CuckooFilter prints its load, a banner
+  // once full and its size when deleted, which go nowhere
+  std::stringstream ignored;
+  std::cout.rdbuf(ignored.rdbuf());
+  CuckooFilter<uint64_t, 12> *plain =
+      new CuckooFilter<uint64_t, 12>(n, 8, TwoIndependentMultiplyShift(1));
+  const size_t capacity = plain->Capacity();
+  const size_t bytes = plain->SizeInBytes();
+  const size_t added = AddAll(plain, capacity);
+  delete plain;
+  std::cout.rdbuf(stdout_buf);
+  Check(capacity < n, "plain budget: Capacity() < max_num_keys");
+  Check(bytes * 8 <= 8 * n, "plain budget: table within it");
+  Check(FillsCapacity(added, capacity), "plain budget: Add up to Capacity()");
+
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,111 @@
+// String and byte-span keys: a key has one KeyDigest() whether it comes as
+// a std::string, a C string or a ByteSpan, and filters over either kind,
+// sharded or not, find every key added, from any copy of its bytes, until
+// it is deleted.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cuckoofilterchange.h"
+#include "shardedcuckoofilter.h"
+
+using check::Check;
+using cuckoofilter::ByteSpan;
+using cuckoofilter::CuckooFilterChangeFLength;
+using cuckoofilter::KeyDigest;
+using cuckoofilter::ShardedCuckooFilter;
+using cuckoofilter::SingleTableWithEncode;
+using cuckoofilter::TwoIndependentMultiplyShift;
+
+namespace {
+
+// keys of several lengths that share long prefixes
+std::string StringKey(const uint64_t k) {
+  return "user/" + std::to_string(k % 97) + "/session/" + std::to_string(k);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  typedef CuckooFilterChangeFLength<std::string, 12, SingleTableWithEncode>
+      StringFilter;
+  typedef CuckooFilterChangeFLength<ByteSpan, 12, SingleTableWithEncode>
+      SpanFilter;
+  const size_t n = check::kSlots * 0.95;
+  const TwoIndependentMultiplyShift hasher(1);
+
+  size_t differ = 0;
+  for (uint64_t k = 0; k < 1000; k++) {
+    const std::string key = StringKey(k);
+    const uint64_t digest = KeyDigest(key, hasher);
+    differ += (KeyDigest(key.c_str(), hasher) != digest) +
+              (KeyDigest(ByteSpan(key.data(), key.size()), hasher) != digest);
+  }
+  Check(differ == 0, "one KeyDigest() per key");
+  const std::string zero("ab\0", 3);
+  Check(KeyDigest(zero, hasher) != KeyDigest(std::string("ab"), hasher),
+        "bytes after a NUL count");
+
+  srand(1);
+  StringFilter strings(n, 0, hasher);
+  srand(1);
+  SpanFilter spans(n, 0, hasher);
+  size_t failures = 0;
+  for (uint64_t k = 0; k < n; k++) {
+    const std::string key = StringKey(k);
+    failures += (strings.Add(key) != cuckoofilter::Ok);
+    failures += (spans.Add(ByteSpan(key.data(), key.size())) !=
+                 cuckoofilter::Ok);
+  }
+  Check(failures == 0, "Add");
+
+  // the span filter reads its keys from another buffer than they were
+  // added from
+  size_t misses = 0;
+  std::vector<char> buffer;
+  for (uint64_t k = 0; k < n; k++) {
+    const std::string key = StringKey(k);
+    buffer.assign(key.begin(), key.end());
+    const ByteSpan span(buffer.data(), buffer.size());
+    misses += (strings.Contain(key) != cuckoofilter::Ok) +
+              (strings.ContainExact(key) != cuckoofilter::Ok) +
+              (spans.Contain(span) != cuckoofilter::Ok) +
+              (spans.ContainExact(span) != cuckoofilter::Ok);
+  }
+  Check(misses == 0, "keys");
+
+  size_t wrong = 0;
+  for (uint64_t k = 0; k < n; k += 2) {
+    const std::string key = StringKey(k);
+    wrong += (strings.Delete(key) != cuckoofilter::Ok) +
+             (spans.Delete(ByteSpan(key.data(), key.size())) !=
+              cuckoofilter::Ok);
+  }
+  for (uint64_t k = 0; k < n; k++) {
+    const std::string key = StringKey(k);
+    const cuckoofilter::Status expected =
+        (k % 2 == 0) ? cuckoofilter::NotFound : cuckoofilter::Ok;
+    wrong += (strings.ContainExact(key) != expected) +
+             (spans.ContainExact(ByteSpan(key.data(), key.size())) !=
+              expected);
+  }
+  Check(wrong == 0, "keys after Delete");
+
+  // 85% load, as the shards get more or fewer keys than their share
+  srand(1);
+  ShardedCuckooFilter<StringFilter, 4> sharded(n, 0, hasher);
+  const size_t m = n * 0.85 / 0.95;
+  failures = misses = 0;
+  for (uint64_t k = 0; k < m; k++) {
+    failures += (sharded.Add(StringKey(k)) != cuckoofilter::Ok);
+  }
+  for (uint64_t k = 0; k < m; k++) {
+    misses += (sharded.ContainExact(StringKey(k)) != cuckoofilter::Ok);
+  }
+  Check(failures == 0, "sharded: Add");
+  Check(misses == 0, "sharded: keys");
+  return check::Done(argv[0]);
+}
@@ -0,0 +1,141 @@
+// ReadTag()/WriteTag() of SingleTableWithEncode against a model of the
+// bucket that branches on the occupancy, as the code did before kSteps:
+// random writes of tags and zeros reach every (t == 0, occupancy, slot)
+// transition, after each one the bucket reads back as the model says and
+// its neighbours read as before.
+
+#include <random>
+#include <string>
+
+#include "check.h"
+#include "singletablewithencode.h"
+
+using check::Check;
+using cuckoofilter::SingleTableWithEncode;
+
+namespace {
+
+const size_t kWrites = 1 << 18;
+
+// the four fields of a bucket at bits_per_tag bits each, and its occupancy
+template <size_t bits_per_tag>
+struct Model {
+  static const uint64_t kMask = (1ULL << bits_per_tag) - 1;
+  static const uint64_t kLongMask = (1ULL << (2 * bits_per_tag)) - 1;
+
+  uint64_t w;
+  uint32_t a;
+
+  Model() : w(0), a(0) {}
+
+  uint32_t Read(const size_t j) const {
+    if (j == 4) {
+      return a;
+    }
+    // one or two entries read as longs in slots 0 and 2
+    const bool isLong = ((a == 1 || a == 2) && j % 2 == 0) ||
+                        (a == 3 && j == 2);
+    const bool isShort = (a == 3 && j < 2) || a == 4;
+    const uint64_t field = w >> (j * bits_per_tag);
+    return isLong ? field & kLongMask : isShort ? field & kMask : 0;
+  }
+
+  void PutLong(const size_t j, const uint32_t t) {
+    w &= ~(kLongMask << (j * bits_per_tag));
+    w |= (t & kLongMask) << (j * bits_per_tag);
+  }
+
+  void PutShort(const size_t j, const uint32_t t) {
+    uint64_t half = (t >> ((j & 1) * bits_per_tag)) & kMask;
+    half += (half == 0);
+    w &= ~(kMask << (j * bits_per_tag));
+    w |= half << (j * bits_per_tag);
+  }
+
+  // PutShort() at j, and the short field at j - 1 set to 1 if it is 0
+  void PutPair(const size_t j, const uint32_t t) {
+    if (((w >> ((j - 1) * bits_per_tag)) & kMask) == 0) {
+      w |= 1ULL << ((j - 1) * bits_per_tag);
+    }
+    PutShort(j, t);
+  }
+
+  void Write(const size_t j, const uint32_t t) {
+    if (t != 0) {
+      if (a == 0 && j % 2 == 0) {
+        PutLong(j, t);
+        a = 1;
+      } else if (a == 1 && j == 2) {
+        PutLong(j, t);
+        a = 2;
+      } else if (a == 2 && j == 1) {
+        PutPair(j, t);
+        a = 3;
+      } else if (a == 3 && j < 2) {
+        PutShort(j, t);
+      } else if (a == 3 && j == 3) {
+        PutPair(j, t);
+        a = 4;
+      } else if (a == 4) {
+        PutShort(j, t);
+      }
+    } else {
+      if ((a == 1 && j == 0) || (a == 2 && j == 2)) {
+        w &= ~(kLongMask << (j * bits_per_tag));
+        a--;
+      } else if ((a == 2 && j == 0) || (a == 3 && j < 2)) {
+        w = (w >> (2 * bits_per_tag)) & kLongMask;
+        a = 1;
+      } else if ((a == 3 && j == 2) || a == 4) {
+        w = 0;
+        a = 0;
+      }
+    }
+  }
+};
+
+template <size_t bits_per_tag>
+void CheckCodec() {
+  const std::string name = std::to_string(bits_per_tag) + "-bit tags";
+  const size_t kBuckets = 4;
+  SingleTableWithEncode<bits_per_tag> table(kBuckets);
+  Model<bits_per_tag> model[kBuckets];
+  std::mt19937_64 rng(bits_per_tag);
+  bool seen[2][5][4] = {};
+  size_t wrong = 0;
+  for (size_t n = 0; n < kWrites && wrong == 0; n++) {
+    const size_t i = rng() % kBuckets;
+    const size_t j = rng() % 4;
+    // writes of a tag outnumber removals, so that full buckets come up
+    const uint32_t t = (rng() % 3 == 0)
+                           ? 0
+                           : (rng() & Model<bits_per_tag>::kLongMask) | 1;
+    seen[t == 0][model[i].a][j] = true;
+    table.WriteTag(i, j, t);
+    model[i].Write(j, t);
+    for (size_t b = 0; b < kBuckets; b++) {
+      for (size_t s = 0; s <= 4; s++) {
+        wrong += (table.ReadTag(b, s) != model[b].Read(s));
+      }
+    }
+  }
+  Check(wrong == 0, name + ": ReadTag after WriteTag");
+  size_t transitions = 0;
+  for (size_t z = 0; z < 2; z++) {
+    for (size_t a = 0; a <= 4; a++) {
+      for (size_t j = 0; j < 4; j++) {
+        transitions += seen[z][a][j];
+      }
+    }
+  }
+  Check(wrong != 0 || transitions == 2 * 5 * 4, name + ": every transition");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  CheckCodec<8>();
+  CheckCodec<12>();
+  CheckCodec<16>();
+  return check::Done(argv[0]);
+}
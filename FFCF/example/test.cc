@@ -34,10 +34,11 @@ int main(int argc, char **argv) {
   for (size_t i = total_items*100 ; i < total_checks + total_items*100; i++) 
   { 
     
-    if (filter.Contain(i) == cuckoofilter::Ok) 
+    CuckooFilterChangeFLength<size_t, 12>::ProbeHandle probe;
+    if (filter.ContainProbe(i, &probe) == cuckoofilter::Ok) 
     {
       false_queries++;
-      if ( filter.ChangeFingerprint(i) == cuckoofilter::Ok)
+      if ( filter.AdaptAt(probe) == cuckoofilter::Ok)
       {
        changes++;
       }
@@ -0,0 +1,213 @@
+#ifndef CUCKOO_FILTER_ADAPTATION_QUEUE_H_
+#define CUCKOO_FILTER_ADAPTATION_QUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cuckoofilter {
+
+// ChangeFingerprint() off the query path. Query threads Push() the keys
+// that turned out to be false positives, without taking a lock, and a
+// worker thread pops them in batches and hands each batch to
+// Filter::ChangeFingerprintHashBatch(), which applies it in bucket order
+// under one writer lock. A full queue drops the key: it stays a false
+// positive until it is pushed again.
+//
+// Filter is CuckooFilterChangeFLength or ShardedCuckooFilter. Queries on
+// other threads need a filter that takes a writer alongside readers: a
+// CuckooFilterChangeFLength in concurrent mode (see SetConcurrent) or a
+// ShardedCuckooFilter. The filter must outlive the queue.
+template <typename Filter>
+class AdaptationQueue {
+  typedef typename Filter::Item ItemType;
+
+  // a bounded multi-producer queue of hashes: cell c is free for the push
+  // of position p once seq == p, and holds that push once seq == p + 1
+  struct Cell {
+    std::atomic<size_t> seq;
+    uint64_t hash;
+  };
+
+  Filter *filter_;
+  Cell *cells_;
+  size_t mask_;
+  size_t batch_size_;
+  std::chrono::microseconds idle_wait_;
+
+  // push and pop positions on cache lines of their own, producers only
+  // ever touch head_
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  alignas(64) std::atomic<size_t> dropped_;
+  std::atomic<size_t> popped_;
+  std::atomic<size_t> applied_;
+
+  // one batch at a time, from the worker or Drain()
+  std::mutex consumer_;
+  std::atomic<bool> stop_;
+  std::thread worker_;
+
+  bool Pop(uint64_t *hash);
+
+  // pop up to batch_size_ hashes and apply them, returns how many popped
+  size_t ApplyBatch(std::vector<uint64_t> &batch);
+
+ public:
+  // capacity is rounded up to a power of two. The worker applies up to
+  // batch_size keys at a time and sleeps idle_wait between empty polls.
+  explicit AdaptationQueue(Filter &filter, const size_t capacity = 1 << 16,
+                           const size_t batch_size = 256,
+                           const std::chrono::microseconds idle_wait =
+                               std::chrono::microseconds(100));
+
+  // stops the worker and applies what is still queued
+  ~AdaptationQueue();
+
+  // Queue item for ChangeFingerprint(). false if the queue was full and
+  // the item was dropped. Lock-free, safe from any number of threads.
+  bool Push(const ItemType &item) { return PushHash(filter_->Hash(item)); }
+  bool PushHash(const uint64_t hash);
+
+  // apply everything queued so far on this thread, returns the number of
+  // keys popped
+  size_t Drain();
+
+  // keys waiting in the queue
+  size_t Depth() const {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+  }
+
+  // keys that found the queue full
+  size_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  // keys popped and handed to the filter
+  size_t Processed() const { return popped_.load(std::memory_order_relaxed); }
+
+  // keys whose fingerprint was changed; the rest no longer collided
+  size_t Applied() const { return applied_.load(std::memory_order_relaxed); }
+
+  size_t Capacity() const { return mask_ + 1; }
+};
+
+template <typename Filter>
+AdaptationQueue<Filter>::AdaptationQueue(
+    Filter &filter, const size_t capacity, const size_t batch_size,
+    const std::chrono::microseconds idle_wait)
+    : filter_(&filter),
+      batch_size_(batch_size > 0 ? batch_size : 1),
+      idle_wait_(idle_wait),
+      head_(0),
+      tail_(0),
+      dropped_(0),
+      popped_(0),
+      applied_(0),
+      stop_(false) {
+  size_t cells = 1;
+  while (cells < capacity) {
+    cells <<= 1;
+  }
+  mask_ = cells - 1;
+  cells_ = new Cell[cells];
+  for (size_t c = 0; c < cells; c++) {
+    cells_[c].seq.store(c, std::memory_order_relaxed);
+  }
+  worker_ = std::thread([this]() {
+    std::vector<uint64_t> batch(batch_size_);
+    while (!stop_.load(std::memory_order_acquire)) {
+      if (ApplyBatch(batch) == 0) {
+        std::this_thread::sleep_for(idle_wait_);
+      }
+    }
+  });
+}
+
+template <typename Filter>
+AdaptationQueue<Filter>::~AdaptationQueue() {
+  stop_.store(true, std::memory_order_release);
+  worker_.join();
+  Drain();
+  delete[] cells_;
+}
+
+template <typename Filter>
+bool AdaptationQueue<Filter>::PushHash(const uint64_t hash) {
+  size_t pos = head_.load(std::memory_order_relaxed);
+  Cell *cell;
+  for (;;) {
+    cell = &cells_[pos & mask_];
+    const size_t seq = cell->seq.load(std::memory_order_acquire);
+    if (seq == pos) {
+      if (head_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (seq < pos) {
+      // the cell still holds the push of one lap ago: full
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->hash = hash;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename Filter>
+bool AdaptationQueue<Filter>::Pop(uint64_t *hash) {
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  Cell *cell;
+  for (;;) {
+    cell = &cells_[pos & mask_];
+    const size_t seq = cell->seq.load(std::memory_order_acquire);
+    if (seq == pos + 1) {
+      if (tail_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (seq < pos + 1) {
+      // empty, or the push of pos has not written its hash yet
+      return false;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  *hash = cell->hash;
+  cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename Filter>
+size_t AdaptationQueue<Filter>::ApplyBatch(std::vector<uint64_t> &batch) {
+  std::lock_guard<std::mutex> guard(consumer_);
+  size_t n = 0;
+  while (n < batch.size() && Pop(&batch[n])) {
+    n++;
+  }
+  if (n > 0) {
+    applied_.fetch_add(filter_->ChangeFingerprintHashBatch(batch.data(), n),
+                       std::memory_order_relaxed);
+    popped_.fetch_add(n, std::memory_order_relaxed);
+  }
+  return n;
+}
+
+template <typename Filter>
+size_t AdaptationQueue<Filter>::Drain() {
+  std::vector<uint64_t> batch(batch_size_);
+  size_t total = 0;
+  for (size_t n; (n = ApplyBatch(batch)) > 0;) {
+    total += n;
+  }
+  return total;
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_ADAPTATION_QUEUE_H_
@@ -0,0 +1,142 @@
+#ifndef CUCKOO_FILTER_BULK_BUILD_H_
+#define CUCKOO_FILTER_BULK_BUILD_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace cuckoofilter {
+
+// BulkBuild() fills the table one block of this many buckets at a time, so
+// that the buckets and items being written stay in the L2 cache.
+const size_t kBulkBuildBlockBuckets = 1 << 14;
+
+// a hashed key; index fits in 32 bits as the filters index buckets with the
+// high 32 bits of the hash
+struct BulkEntry {
+  uint64_t item;
+  uint32_t index;
+  uint32_t tag;
+};
+
+// Runs body(t) for t in [0, threads) on threads of its own and waits for
+// them.
+template <typename Body>
+void RunOnThreads(const unsigned threads, Body body) {
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.push_back(std::thread(body, t));
+  }
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+}
+
+// Orders entries by the block of bucket entry.index with a counting sort,
+// stable within each block, then every thread takes a contiguous run of
+// blocks and calls place(entry) for its entries in order. Both passes
+// stream through their input; only the writes of place() are scattered,
+// and those stay within a block. Each bucket is written by a single
+// thread, so place() must not write outside of bucket entry.index.
+// Rejected entries are appended to *overflow, the return value is the
+// number place() accepted.
+template <typename PlaceFn>
+size_t PlaceByBlock(const std::vector<BulkEntry> &entries,
+                    const size_t num_buckets, const unsigned threads,
+                    PlaceFn place, std::vector<BulkEntry> *overflow) {
+  const size_t n = entries.size();
+  size_t block_shift = 0;
+  while ((num_buckets >> block_shift) > 1 &&
+         (1ULL << block_shift) < kBulkBuildBlockBuckets) {
+    block_shift++;
+  }
+  const size_t num_blocks = std::max<size_t>(1, num_buckets >> block_shift);
+
+  std::vector<BulkEntry> sorted(n);
+  // counts[c * num_blocks + b]: entries of chunk c in block b, then the
+  // position in sorted[] the next of them goes to
+  std::vector<size_t> counts(threads * num_blocks, 0);
+  std::vector<size_t> block_start(num_blocks + 1);
+  std::vector<std::vector<BulkEntry> > overflows(threads);
+  std::vector<size_t> placed(threads, 0);
+
+  RunOnThreads(threads, [&](const unsigned c) {
+    size_t *count = &counts[c * num_blocks];
+    for (size_t k = c * n / threads; k < (c + 1) * n / threads; k++) {
+      count[entries[k].index >> block_shift]++;
+    }
+  });
+  // block-major prefix sums, so each chunk scatters to its own ranges
+  size_t pos = 0;
+  for (size_t b = 0; b < num_blocks; b++) {
+    block_start[b] = pos;
+    for (unsigned c = 0; c < threads; c++) {
+      const size_t count = counts[c * num_blocks + b];
+      counts[c * num_blocks + b] = pos;
+      pos += count;
+    }
+  }
+  block_start[num_blocks] = pos;
+  RunOnThreads(threads, [&](const unsigned c) {
+    size_t *next = &counts[c * num_blocks];
+    for (size_t k = c * n / threads; k < (c + 1) * n / threads; k++) {
+      sorted[next[entries[k].index >> block_shift]++] = entries[k];
+    }
+  });
+
+  RunOnThreads(threads, [&](const unsigned t) {
+    const size_t begin = block_start[t * num_blocks / threads];
+    const size_t end = block_start[(t + 1) * num_blocks / threads];
+    size_t count = 0;
+    for (size_t p = begin; p < end; p++) {
+      if (place(sorted[p])) {
+        count++;
+      } else {
+        overflows[t].push_back(sorted[p]);
+      }
+    }
+    placed[t] = count;
+  });
+  size_t total = 0;
+  for (unsigned t = 0; t < threads; t++) {
+    total += placed[t];
+    overflow->insert(overflow->end(), overflows[t].begin(),
+                     overflows[t].end());
+  }
+  return total;
+}
+
+// The parallel part of BulkBuild() for n keys and a table of num_buckets
+// buckets: hash(k, &entry) hashes key k into its primary bucket and tag on
+// `threads` threads (0: one per core), PlaceByBlock() places the entries
+// in their primary buckets, then the ones left over in their alternate
+// buckets alt(index, tag). What still does not fit is left in *overflow
+// for the caller to kick in; the return value is the number placed.
+template <typename HashFn, typename AltFn, typename PlaceFn>
+size_t PartitionedPlace(const size_t n, const size_t num_buckets,
+                        unsigned threads, HashFn hash, AltFn alt,
+                        PlaceFn place, std::vector<BulkEntry> *overflow) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::max<size_t>(1, std::min<size_t>(threads, n));
+
+  std::vector<BulkEntry> entries(n);
+  RunOnThreads(threads, [&](const unsigned c) {
+    for (size_t k = c * n / threads; k < (c + 1) * n / threads; k++) {
+      hash(k, &entries[k]);
+    }
+  });
+  std::vector<BulkEntry> rest;
+  size_t placed = PlaceByBlock(entries, num_buckets, threads, place, &rest);
+
+  for (size_t k = 0; k < rest.size(); k++) {
+    rest[k].index = alt(rest[k].index, rest[k].tag);
+  }
+  placed += PlaceByBlock(rest, num_buckets, threads, place, overflow);
+  return placed;
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_BULK_BUILD_H_
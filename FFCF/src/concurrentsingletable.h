@@ -0,0 +1,214 @@
+#ifndef CUCKOO_FILTER_CONCURRENT_SINGLE_TABLE_H_
+#define CUCKOO_FILTER_CONCURRENT_SINGLE_TABLE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <sstream>
+#include <type_traits>
+
+#include "bitsutil.h"
+
+namespace cuckoofilter {
+
+// SingleTable for tags of up to 16 bits, with each bucket in a word of its
+// own that is read and written atomically: 32 bits for 4 and 8-bit tags,
+// 64 bits above. Inserts and deletes are a compare-and-swap of the bucket
+// word, so any number of threads may insert at once. WriteSlot() and kick
+// outs overwrite entries and need their callers to serialize them.
+// An insert first claims a free slot, then writes its item and only then
+// publishes the tag, so whoever reads a tag reads its item as well.
+template <size_t bits_per_tag>
+class ConcurrentSingleTable {
+  static_assert(bits_per_tag * 4 <= 64, "a bucket must fit in one word");
+
+  typedef typename std::conditional<bits_per_tag * 4 <= 32, uint32_t,
+                                    uint64_t>::type Word;
+
+  static const size_t kTagsPerBucket = 4;
+  static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+
+  std::atomic<Word> *buckets_;
+  std::atomic<uint64_t> *items_;
+  // the free slots of each bucket that an insert has claimed for its item
+  // but not yet published a tag in
+  std::atomic<uint8_t> *claims_;
+  size_t num_buckets_;
+
+  static inline uint32_t TagOf(const Word w, const size_t j) {
+    return (w >> (j * bits_per_tag)) & kTagMask;
+  }
+
+  static inline Word WithTag(const Word w, const size_t j,
+                             const uint32_t tag) {
+    const size_t shift = j * bits_per_tag;
+    return (w & ~((Word)kTagMask << shift)) | ((Word)tag << shift);
+  }
+
+  static inline bool HasTag(const uint64_t w, const uint32_t tag) {
+    if (bits_per_tag == 4) {
+      return hasvalue4(w, tag);
+    } else if (bits_per_tag == 8) {
+      return hasvalue8(w, tag);
+    } else if (bits_per_tag == 12) {
+      return hasvalue12(w, tag);
+    } else if (bits_per_tag == 16) {
+      return hasvalue16(w, tag);
+    }
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (TagOf(w, j) == tag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ public:
+  explicit ConcurrentSingleTable(const size_t num) : num_buckets_(num) {
+    buckets_ = new std::atomic<Word>[num_buckets_]();
+    items_ = new std::atomic<uint64_t>[num_buckets_ * kTagsPerBucket]();
+    claims_ = new std::atomic<uint8_t>[num_buckets_]();
+  }
+
+  ~ConcurrentSingleTable() {
+    delete[] buckets_;
+    delete[] items_;
+    delete[] claims_;
+  }
+
+  size_t NumBuckets() const { return num_buckets_; }
+
+  size_t SizeInBytes() const { return sizeof(Word) * num_buckets_; }
+
+  size_t SizeInTags() const { return kTagsPerBucket * num_buckets_; }
+
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "ConcurrentSingleHashtable with tag size: " << bits_per_tag
+       << " bits \n";
+    ss << "\t\tAssociativity: " << kTagsPerBucket << "\n";
+    ss << "\t\tTotal # of rows: " << num_buckets_ << "\n";
+    ss << "\t\tTotal # slots: " << SizeInTags() << "\n";
+    return ss.str();
+  }
+
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(&buckets_[i]);
+  }
+
+  inline uint32_t ReadTag(const size_t i, const size_t j) const {
+    return TagOf(buckets_[i].load(std::memory_order_acquire), j);
+  }
+
+  inline bool FindTagInBuckets(const size_t i1, const size_t i2,
+                               const uint32_t tag) const {
+    return HasTag(buckets_[i1].load(std::memory_order_acquire), tag) ||
+           HasTag(buckets_[i2].load(std::memory_order_acquire), tag);
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
+    return HasTag(buckets_[i].load(std::memory_order_acquire), tag);
+  }
+
+  inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    Word w = buckets_[i].load(std::memory_order_relaxed);
+    for (;;) {
+      size_t j = 0;
+      while (j < kTagsPerBucket && TagOf(w, j) != tag) {
+        j++;
+      }
+      if (j == kTagsPerBucket) {
+        return false;
+      }
+      if (buckets_[i].compare_exchange_weak(w, WithTag(w, j, 0),
+                                            std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+  }
+
+  inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
+                                const bool kickout, uint32_t &oldtag,
+                                const uint64_t item, uint64_t &olditem) {
+    Word w;
+    for (;;) {
+      w = buckets_[i].load(std::memory_order_acquire);
+      uint8_t claims = claims_[i].load(std::memory_order_acquire);
+      size_t j = 0;
+      while (j < kTagsPerBucket &&
+             (TagOf(w, j) != 0 || ((claims >> j) & 1) != 0)) {
+        j++;
+      }
+      if (j == kTagsPerBucket) {
+        break;
+      }
+      if (!claims_[i].compare_exchange_weak(claims, claims | (1U << j),
+                                            std::memory_order_acq_rel)) {
+        continue;
+      }
+      // another insert may have filled the slot and dropped its claim
+      // since w was read
+      w = buckets_[i].load(std::memory_order_acquire);
+      if (TagOf(w, j) == 0) {
+        items_[i * kTagsPerBucket + j].store(item, std::memory_order_relaxed);
+        while (!buckets_[i].compare_exchange_weak(
+            w, WithTag(w, j, tag), std::memory_order_acq_rel)) {
+        }
+      }
+      claims_[i].fetch_and((uint8_t) ~(1U << j), std::memory_order_release);
+      if (TagOf(w, j) == 0) {
+        return true;
+      }
+    }
+    if (kickout) {
+      size_t r = rand() % kTagsPerBucket;
+      olditem = items_[i * kTagsPerBucket + r].exchange(
+          item, std::memory_order_relaxed);
+      while (!buckets_[i].compare_exchange_weak(w, WithTag(w, r, tag),
+                                                std::memory_order_acq_rel)) {
+      }
+      oldtag = TagOf(w, r);
+    }
+    return false;
+  }
+
+  inline uint64_t ReadItem(const size_t i, const size_t j) const {
+    return items_[i * kTagsPerBucket + j].load(std::memory_order_relaxed);
+  }
+
+  // overwrite the entry in slot j of bucket i, used to shift entries along
+  // a cuckoo path; inserts into the other slots may race with it. The item
+  // goes first, a reader may pair the old tag with it, never the new tag
+  // with the old item.
+  inline void WriteSlot(const size_t i, const size_t j, const uint32_t tag,
+                        const uint64_t item) {
+    items_[i * kTagsPerBucket + j].store(item, std::memory_order_relaxed);
+    Word w = buckets_[i].load(std::memory_order_relaxed);
+    while (!buckets_[i].compare_exchange_weak(w, WithTag(w, j, tag),
+                                              std::memory_order_acq_rel)) {
+    }
+  }
+
+  inline size_t NumTagsInBucket(const size_t i) const {
+    const Word w = buckets_[i].load(std::memory_order_acquire);
+    size_t num = 0;
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      num += TagOf(w, j) != 0;
+    }
+    return num;
+  }
+};
+
+// whether a table takes concurrent inserts, see ConcurrentSingleTable
+template <typename Table>
+struct TableTraits {
+  static const bool kConcurrent = false;
+};
+
+template <size_t bits_per_tag>
+struct TableTraits<ConcurrentSingleTable<bits_per_tag> > {
+  static const bool kConcurrent = true;
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CONCURRENT_SINGLE_TABLE_H_
@@ -2,33 +2,42 @@
 #define CUCKOO_FILTER_CUCKOO_FILTER_H_
 
 #include <assert.h>
+#include <math.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
+#include "bulkbuild.h"
+#include "concurrentsingletable.h"
 #include "debug.h"
 #include "hashutil.h"
 #include "packedtable.h"
 #include "printutil.h"
+#include "seqlock.h"
 #include "singletable.h"
+#include "status.h"
 
 namespace cuckoofilter {
-// status returned by a cuckoo filter operation
-enum Status {
-  Ok = 0,
-  NotFound = 1,
-  NotEnoughSpace = 2,
-  NotSupported = 3,
-};
-
-// maximum number of cuckoo kicks before claiming failure
-const size_t kMaxCuckooCount = 500;
 
 // A cuckoo filter class exposes a Bloomier filter interface,
 // providing methods of Add, Delete, Contain. It takes three
 // template parameters:
-//   ItemType:  the type of item you want to insert
+//   ItemType:  the type of item you want to insert, an integer, std::string,
+//              std::string_view, ByteSpan or another type with a KeyDigest()
 //   bits_per_item: how many bits each item is hashed into
 //   TableType: the storage of table, SingleTable by default, and
 // PackedTable to enable semi-sorting
+//
+// With ConcurrentSingleTable any number of threads may call Add, Delete and
+// Contain at once. An Add whose buckets have a free slot claims it with a
+// compare-and-swap, without a lock; only the cuckoo path search when both
+// are full, and Delete, serialize on a lock. Entries on a path are shifted
+// as in PathSearch mode and the buckets they leave are marked in a
+// StripedSeqLock, so Contain never misses an entry that is being moved.
+// There is no victim cache then: an Add that finds no path returns
+// NotEnoughSpace and leaves the filter as it was. BulkBuild must not
+// overlap any other call.
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType = SingleTable,
           typename HashFamily = TwoIndependentMultiplyShift>
@@ -37,11 +46,12 @@ class CuckooFilter {
   TableType<bits_per_item> *table_;
 
   // Number of items stored
-  size_t num_items_;
+  std::atomic<size_t> num_items_;
 
   typedef struct {
     size_t index;
     uint32_t tag;
+    uint64_t item;
     bool used;
   } VictimCache;
 
@@ -49,6 +59,35 @@ class CuckooFilter {
 
   HashFamily hasher_;
 
+  InsertMode insert_mode_;
+
+  static const size_t kTagsPerBucket = 4;
+
+  static const bool kConcurrent =
+      TableTraits<TableType<bits_per_item> >::kConcurrent;
+
+  // stripes of the buckets kicks move entries out of and the kick lock,
+  // with a concurrent table only
+  StripedSeqLock *seqlock_;
+
+  inline void CountItems(const int delta) {
+    if (kConcurrent) {
+      num_items_.fetch_add(delta, std::memory_order_relaxed);
+    } else {
+      num_items_.store(num_items_.load(std::memory_order_relaxed) + delta,
+                       std::memory_order_relaxed);
+    }
+  }
+
+  // A full bucket reached by the path search: slot `slot` of the bucket of
+  // node `parent` holds an entry whose alternate bucket this is. The two
+  // buckets of the new item are the roots, with parent -1.
+  struct PathNode {
+    size_t bucket;
+    int parent;
+    size_t slot;
+  };
+
   inline size_t IndexHash(uint32_t hv) const {
     return hv & (table_->NumBuckets() - 1);
   }
@@ -60,9 +99,14 @@ class CuckooFilter {
     return tag;
   }
 
-  inline void GenerateIndexTagHash(const ItemType &item, size_t *index,
+  // item is the KeyDigest() of a key
+  inline void GenerateIndexTagHash(const uint64_t item, size_t *index,
                                    uint32_t *tag) const {
-    const uint64_t hash = hasher_(item);
+    IndexTagFromHash(hasher_(item), index, tag);
+  }
+
+  inline void IndexTagFromHash(const uint64_t hash, size_t *index,
+                               uint32_t *tag) const {
     *index = IndexHash(hash >> 32);
     *tag = TagHash(hash);
   }
@@ -71,7 +115,24 @@ class CuckooFilter {
     return IndexHash((uint32_t)(index ^ (tag * 0x5bd1e995)));
   }
 
-  Status AddImpl(const size_t i, const uint32_t tag, const ItemType &item);
+  Status AddImpl(const size_t i, const uint32_t tag, const uint64_t item);
+
+  // Place an entry whose buckets i1 and i2 are both full by shifting the
+  // entries along the shortest cuckoo path. False if no path was found
+  // within kMaxPathSearchBuckets buckets, the table is left as it was.
+  // Each entry is written to its new bucket before its old slot is
+  // overwritten, so that concurrent readers always find it.
+  bool AddByPathSearch(const size_t i1, const size_t i2, const uint32_t tag,
+                       const uint64_t item);
+
+  inline bool OnPath(const PathNode *path, int n, const size_t bucket) const {
+    for (; n >= 0; n = path[n].parent) {
+      if (path[n].bucket == bucket) {
+        return true;
+      }
+    }
+    return false;
+  }
 
   /**
    * @brief
@@ -81,21 +142,56 @@ class CuckooFilter {
    * @return Status
    */
   Status AddImplWithFN(const size_t i, const uint32_t tag,
-                       const size_t var_kMaxCuckooCount, const ItemType &item);
+                       const size_t var_kMaxCuckooCount, const uint64_t item);
+
+  // Contain() of an index and tag with a concurrent table: probe again
+  // while a kick moved an entry out of one of the two buckets
+  inline bool FindTagConcurrent(const size_t i1, const size_t i2,
+                                const uint32_t tag) const {
+    const size_t s1 = StripedSeqLock::Stripe(i1);
+    const size_t s2 = StripedSeqLock::Stripe(i2);
+    uint32_t v1, v2;
+    bool found;
+    do {
+      v1 = seqlock_->ReadBegin(s1);
+      v2 = seqlock_->ReadBegin(s2);
+      found = table_->FindTagInBuckets(i1, i2, tag);
+    } while (seqlock_->ReadRetry(s1, v1) || seqlock_->ReadRetry(s2, v2));
+    return found;
+  }
 
   // load factor is the fraction of occupancy
   double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
   double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
 
  public:
-  explicit CuckooFilter(const size_t max_num_keys)
-      : num_items_(0), victim_(), hasher_() {
+  typedef ItemType Item;
+  typedef HashFamily Hasher;
+
+  // The table gets the smallest power-of-two number of buckets that holds
+  // max_num_keys at kTargetLoadFactor. A positive bits_per_key caps the
+  // table so that it never costs more than bits_per_key * max_num_keys bits,
+  // even if it then holds fewer keys, see Capacity().
+  // The filter hashes with a copy of hasher, randomly seeded by default.
+  explicit CuckooFilter(const size_t max_num_keys,
+                        const double bits_per_key = 0,
+                        const HashFamily &hasher = HashFamily())
+      : num_items_(0),
+        victim_(),
+        hasher_(hasher),
+        insert_mode_(RandomWalk),
+        seqlock_(kConcurrent ? new StripedSeqLock() : NULL) {
     size_t assoc = 4;
-    size_t num_buckets = 8192;
-    double frac = (double)max_num_keys / num_buckets / assoc;
-    if (frac > 0.96) {
-      std::cout << "CF might fail." << std::endl;
+    size_t num_buckets = upperpower2(std::max<uint64_t>(
+        1, ceil(max_num_keys / kTargetLoadFactor / assoc)));
+    if (bits_per_key > 0) {
+      while (num_buckets > 1 &&
+             num_buckets * assoc * bits_per_item >
+                 bits_per_key * max_num_keys) {
+        num_buckets >>= 1;
+      }
     }
+    double frac = (double)max_num_keys / num_buckets / assoc;
     victim_.used = false;
     table_ = new TableType<bits_per_item>(num_buckets);
     std::cout << "load is: " << frac << std::endl;
@@ -104,26 +200,69 @@ class CuckooFilter {
   ~CuckooFilter() {
     std::cout << "Byte size is: " << SizeInBytes() << std::endl;
     delete table_;
+    delete seqlock_;
   }
 
   // Add an item to the filter.
   Status Add(const ItemType &item);
 
+  // Add() of a key whose KeyDigest() and its HashDigest() are known.
+  Status AddHash(const uint64_t item, const uint64_t hash);
+
+  // RandomWalk by default. PathSearch reaches a higher load factor before
+  // the first failure and keeps the kick chains short near full occupancy.
+  void SetInsertMode(const InsertMode mode) { insert_mode_ = mode; }
+
+  // Add n keys at once. They are hashed on `threads` threads (0: one per
+  // core), ordered by the block of buckets their primary bucket is in, and
+  // every thread fills its own blocks, so the table is written mostly in
+  // cache. Keys whose primary bucket is full are added with cuckoo kicks
+  // afterwards on this thread. NotEnoughSpace if the filter filled up
+  // before all keys were in.
+  Status BulkBuild(const ItemType *keys, const size_t n,
+                   const unsigned threads = 0);
+
   // Add an item to the filter.
   Status AddWithFN(const ItemType &item, const size_t var_kMaxCuckooCount = 16);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain() for an item whose hash has already been computed by Hash(),
+  // so that a caller that routes keys by their hash hashes each only once.
+  Status ContainHash(const uint64_t hash) const;
+
+  uint64_t Digest(const ItemType &item) const {
+    return KeyDigest(item, hasher_);
+  }
+  uint64_t Hash(const ItemType &item) const { return hasher_(Digest(item)); }
+  uint64_t HashDigest(const uint64_t digest) const { return hasher_(digest); }
+
+  // Contain() for n keys: a window of keys is hashed and both candidate
+  // buckets of each are prefetched before any of them is probed, so their
+  // cache misses overlap. out[k] receives the Status of keys[k].
+  void ContainBatch(const ItemType *keys, const size_t n, uint8_t *out) const;
+
   // Delete an key from the filter
   Status Delete(const ItemType &item);
+  Status DeleteHash(const uint64_t hash);
+  // DeleteHash(), as there are no items to tell keys of the same tag apart
+  Status DeleteExactHash(const uint64_t item, const uint64_t hash) {
+    return DeleteHash(hash);
+  }
 
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
 
   // number of current inserted items;
-  size_t Size() const { return num_items_; }
+  size_t Size() const { return num_items_.load(std::memory_order_relaxed); }
+
+  // number of keys the table holds at kTargetLoadFactor; below the
+  // max_num_keys of the ctor when bits_per_key cut the table
+  size_t Capacity() const {
+    return table_->SizeInTags() * kTargetLoadFactor;
+  }
 
   // size of the filter in bytes.
   size_t SizeInBytes() const { return table_->SizeInBytes(); }
@@ -133,12 +272,20 @@ template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Add(
     const ItemType &item) {
+  const uint64_t digest = KeyDigest(item, hasher_);
+  return AddHash(digest, hasher_(digest));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddHash(
+    const uint64_t item, const uint64_t hash) {
   size_t i;
   uint32_t tag;
 
   if (victim_.used) {
     std::cout << std::string(80, '=') << std::endl;
-    if (Contain(item) == Ok) {
+    if (ContainHash(hash) == Ok) {
       std::cout << "Item was already in the set." << std::endl;
     } else {
       std::cout << "Item was not already in the set." << std::endl;
@@ -149,10 +296,54 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Add(
     return NotEnoughSpace;
   }
 
-  GenerateIndexTagHash(item, &i, &tag);
+  IndexTagFromHash(hash, &i, &tag);
   return AddImpl(i, tag, item);
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::BulkBuild(
+    const ItemType *keys, const size_t n, const unsigned threads) {
+  std::vector<BulkEntry> overflow;
+
+  if (victim_.used) {
+    return NotEnoughSpace;
+  }
+  // InsertTagToBucket only writes the bytes of its own bucket
+  num_items_ += PartitionedPlace(
+      n, table_->NumBuckets(), threads,
+      [&](const size_t k, BulkEntry *entry) {
+        size_t index;
+        entry->item = KeyDigest(keys[k], hasher_);
+        GenerateIndexTagHash(entry->item, &index, &entry->tag);
+        entry->index = index;
+      },
+      [&](const size_t index, const uint32_t tag) {
+        return AltIndex(index, tag);
+      },
+      [&](const BulkEntry &entry) {
+        uint32_t oldtag;
+        uint64_t olditem;
+        return table_->InsertTagToBucket(entry.index, entry.tag, false,
+                                         oldtag, entry.item, olditem);
+      },
+      &overflow);
+
+  // both buckets of these are full, so search for short cuckoo paths
+  const InsertMode mode = insert_mode_;
+  insert_mode_ = PathSearch;
+  Status status = Ok;
+  for (size_t o = 0; o < overflow.size() && status == Ok; o++) {
+    if (victim_.used) {
+      status = NotEnoughSpace;
+    } else {
+      status = AddImpl(overflow[o].index, overflow[o].tag, overflow[o].item);
+    }
+  }
+  insert_mode_ = mode;
+  return status;
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddWithFN(
@@ -160,26 +351,57 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddWithFN(
   size_t i;
   uint32_t tag;
 
-  GenerateIndexTagHash(item, &i, &tag);
-  return AddImpl(i, tag, item);
+  const uint64_t digest = KeyDigest(item, hasher_);
+  GenerateIndexTagHash(digest, &i, &tag);
+  return AddImpl(i, tag, digest);
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddImpl(
-    const size_t i, const uint32_t tag, const ItemType &item) {
+    const size_t i, const uint32_t tag, const uint64_t item) {
   size_t curindex = i;
   uint32_t curtag = tag;
   uint32_t oldtag;
   uint64_t curitem = item;
   uint64_t olditem;
 
+  if (kConcurrent) {
+    const size_t i2 = AltIndex(i, tag);
+    if (table_->InsertTagToBucket(i, tag, false, oldtag, item, olditem) ||
+        table_->InsertTagToBucket(i2, tag, false, oldtag, item, olditem)) {
+      CountItems(1);
+      return Ok;
+    }
+    // both buckets are full: look for a path under the kick lock, Delete
+    // may have made room meanwhile
+    std::lock_guard<std::mutex> lock(seqlock_->writer);
+    if (table_->InsertTagToBucket(i, tag, false, oldtag, item, olditem) ||
+        table_->InsertTagToBucket(i2, tag, false, oldtag, item, olditem) ||
+        AddByPathSearch(i, i2, tag, item)) {
+      CountItems(1);
+      return Ok;
+    }
+    return NotEnoughSpace;
+  }
+
+  if (insert_mode_ == PathSearch) {
+    const size_t i2 = AltIndex(i, tag);
+    if (table_->InsertTagToBucket(i, tag, false, oldtag, item, olditem) ||
+        table_->InsertTagToBucket(i2, tag, false, oldtag, item, olditem) ||
+        AddByPathSearch(i, i2, tag, item)) {
+      CountItems(1);
+      return Ok;
+    }
+    // no short path, the random walk below ends in the victim cache
+  }
+
   for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
     bool kickout = count > 0;
     oldtag = 0;
     if (table_->InsertTagToBucket(curindex, curtag, kickout, oldtag, curitem,
                                   olditem)) {
-      num_items_++;
+      CountItems(1);
       return Ok;
     }
     if (kickout) {
@@ -191,17 +413,84 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddImpl(
 
   victim_.index = curindex;
   victim_.tag = curtag;
+  victim_.item = curitem;
   victim_.used = true;
   return Ok;
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilter<ItemType, bits_per_item, TableType,
+                  HashFamily>::AddByPathSearch(const size_t i1, const size_t i2,
+                                               const uint32_t tag,
+                                               const uint64_t item) {
+  PathNode path[kMaxPathSearchBuckets];
+  uint32_t tags[kTagsPerBucket];
+  size_t alts[kTagsPerBucket];
+  uint32_t oldtag;
+  uint64_t olditem;
+  size_t tail = 0;
+
+  path[tail].bucket = i1;
+  path[tail].parent = -1;
+  tail++;
+  path[tail].bucket = i2;
+  path[tail].parent = -1;
+  tail++;
+
+  for (size_t head = 0; head < tail; head++) {
+    const size_t b = path[head].bucket;
+    // start loading all alternate buckets before looking at any of them
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      tags[j] = table_->ReadTag(b, j);
+      alts[j] = AltIndex(b, tags[j]);
+      table_->PrefetchBucket(alts[j]);
+    }
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      // a concurrent insert may take the free slot first, the bucket is
+      // expanded as a full one then
+      if (table_->NumTagsInBucket(alts[j]) < kTagsPerBucket &&
+          table_->InsertTagToBucket(alts[j], tags[j], false, oldtag,
+                                    table_->ReadItem(b, j), olditem)) {
+        // Shift from the free end back to a root: each entry moves into
+        // the slot that its successor on the path has just left.
+        int n = head;
+        size_t slot = j;
+        while (path[n].parent >= 0) {
+          const size_t from = path[path[n].parent].bucket;
+          StripeWriteGuard guard(seqlock_,
+                                 StripedSeqLock::Stripe(path[n].bucket),
+                                 StripedSeqLock::Stripe(path[n].bucket));
+          table_->WriteSlot(path[n].bucket, slot,
+                            table_->ReadTag(from, path[n].slot),
+                            table_->ReadItem(from, path[n].slot));
+          slot = path[n].slot;
+          n = path[n].parent;
+        }
+        StripeWriteGuard guard(seqlock_,
+                               StripedSeqLock::Stripe(path[n].bucket),
+                               StripedSeqLock::Stripe(path[n].bucket));
+        table_->WriteSlot(path[n].bucket, slot, tag, item);
+        return true;
+      }
+      if (tail < kMaxPathSearchBuckets && !OnPath(path, head, alts[j])) {
+        path[tail].bucket = alts[j];
+        path[tail].parent = head;
+        path[tail].slot = j;
+        tail++;
+      }
+    }
+  }
+  return false;
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType,
                     HashFamily>::AddImplWithFN(const size_t i,
                                                const uint32_t tag,
                                                const size_t var_kMaxCuckooCount,
-                                               const ItemType &item) {
+                                               const uint64_t item) {
   size_t curindex = i;
   uint32_t curtag = tag;
   uint32_t oldtag;
@@ -213,7 +502,7 @@ Status CuckooFilter<ItemType, bits_per_item, TableType,
     oldtag = 0;
     if (table_->InsertTagToBucket(curindex, curtag, kickout, oldtag, curitem,
                                   olditem)) {
-      num_items_++;
+      CountItems(1);
       return Ok;
     }
     if (kickout) {
@@ -228,15 +517,26 @@ template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Contain(
     const ItemType &key) const {
+  return ContainHash(Hash(key));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilter<ItemType, bits_per_item, TableType,
+                    HashFamily>::ContainHash(const uint64_t hash) const {
   bool found = false;
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
   assert(i1 == AltIndex(i2, tag));
 
+  if (kConcurrent) {
+    return FindTagConcurrent(i1, i2, tag) ? Ok : NotFound;
+  }
+
   found = victim_.used && (tag == victim_.tag) &&
           (i1 == victim_.index || i2 == victim_.index);
 
@@ -247,21 +547,70 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Contain(
   }
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::ContainBatch(
+    const ItemType *keys, const size_t n, uint8_t *out) const {
+  size_t i1[kContainBatchWindow], i2[kContainBatchWindow];
+  uint32_t tag[kContainBatchWindow];
+
+  for (size_t base = 0; base < n; base += kContainBatchWindow) {
+    const size_t m = std::min(kContainBatchWindow, n - base);
+    for (size_t k = 0; k < m; k++) {
+      GenerateIndexTagHash(Digest(keys[base + k]), &i1[k], &tag[k]);
+      i2[k] = AltIndex(i1[k], tag[k]);
+      table_->PrefetchBucket(i1[k]);
+      table_->PrefetchBucket(i2[k]);
+    }
+    for (size_t k = 0; k < m; k++) {
+      if (kConcurrent) {
+        out[base + k] =
+            FindTagConcurrent(i1[k], i2[k], tag[k]) ? Ok : NotFound;
+        continue;
+      }
+      bool found = victim_.used && (tag[k] == victim_.tag) &&
+                   (i1[k] == victim_.index || i2[k] == victim_.index);
+      out[base + k] =
+          (found || table_->FindTagInBuckets(i1[k], i2[k], tag[k])) ? Ok
+                                                                    : NotFound;
+    }
+  }
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Delete(
     const ItemType &key) {
+  return DeleteHash(Hash(key));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilter<ItemType, bits_per_item, TableType,
+                    HashFamily>::DeleteHash(const uint64_t hash) {
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
+  if (kConcurrent) {
+    // under the kick lock, so that a kick never moves an entry that is
+    // being deleted
+    std::lock_guard<std::mutex> lock(seqlock_->writer);
+    if (table_->DeleteTagFromBucket(i1, tag) ||
+        table_->DeleteTagFromBucket(i2, tag)) {
+      CountItems(-1);
+      return Ok;
+    }
+    return NotFound;
+  }
+
   if (table_->DeleteTagFromBucket(i1, tag)) {
-    num_items_--;
+    CountItems(-1);
     goto TryEliminateVictim;
   } else if (table_->DeleteTagFromBucket(i2, tag)) {
-    num_items_--;
+    CountItems(-1);
     goto TryEliminateVictim;
   } else if (victim_.used && tag == victim_.tag &&
              (i1 == victim_.index || i2 == victim_.index)) {
@@ -276,7 +625,7 @@ TryEliminateVictim:
     victim_.used = false;
     size_t i = victim_.index;
     uint32_t tag = victim_.tag;
-    AddImpl(i, tag, key);
+    AddImpl(i, tag, victim_.item);
   }
   return Ok;
 }
@@ -2,25 +2,27 @@
 #define CUCKOO_FILTER_CUCKOO_FILTER_CHANGE_H_
 
 #include <assert.h>
+#include <math.h>
 #include <algorithm>
+#include <istream>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
 
+#include "bulkbuild.h"
 #include "debug.h"
+#include "filterformat.h"
 #include "hashutil.h"
 #include "packedtable.h"
 #include "printutil.h"
+#include "seqlock.h"
 #include "singletablewithencode.h"
+#include "status.h"
 
 namespace cuckoofilter {
-// status returned by a cuckoo filter operation
-enum Status {
-  Ok = 0,
-  NotFound = 1,
-  NotEnoughSpace = 2,
-  NotSupported = 3,
-};
-
-// maximum number of cuckoo kicks before claiming failure
-const size_t kMaxCuckooCount = 500;
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType = SingleTableWithEncode,
@@ -33,12 +35,49 @@ class CuckooFilterChangeFLength {
   typedef struct {
     size_t index;
     uint32_t tag;
+    uint64_t item;
     bool used;
   } VictimCache;
 
   VictimCache victim_;
 
   HashFamily hasher_;
+  // handed to every table made, see itemstore.h
+  typename TableType<bits_per_item>::StoreOptions store_options_;
+
+  InsertMode insert_mode_;
+
+  static const size_t kTagsPerBucket = 4;
+  // buckets whose items ExportItems() loads at once
+  static const size_t kExportBatch = 64;
+
+  // A full bucket reached by the path search: slot `slot` of the bucket of
+  // node `parent` holds an entry whose alternate bucket this is. The two
+  // buckets of the new item are the roots, with parent -1.
+  struct PathNode {
+    size_t bucket;
+    int parent;
+    size_t slot;
+  };
+
+  // grow once the load factor reaches this value, 0 disables auto-grow
+  double grow_load_factor_;
+
+  // Incremental growth: while old_table_ is set, buckets [0, migrate_pos_)
+  // of it have been moved into table_, and so have the later buckets that
+  // Delete() moved ahead of time, as marked in migrated_. grow_step_
+  // buckets are moved per mutation, 0 means Grow() at once.
+  TableType<bits_per_item> *old_table_;
+  std::vector<bool> migrated_;
+  size_t migrate_pos_;
+  size_t grow_step_;
+
+  // the file table_ is a view of after Map(), NULL for a filter of its own
+  char *mapping_;
+  size_t mapping_size_;
+
+  // set in concurrent mode, see SetConcurrent()
+  StripedSeqLock *seqlock_;
 
   inline size_t IndexHash(uint32_t hv) const {
     return hv & (table_->NumBuckets() - 1);
@@ -51,18 +90,100 @@ class CuckooFilterChangeFLength {
     return tag;
   }
 
-  inline void GenerateIndexTagHash(const ItemType &item, size_t *index,
+  // item is the KeyDigest() of a key
+  inline void GenerateIndexTagHash(const uint64_t item, size_t *index,
                                    uint32_t *tag) const {
-    const uint64_t hash = hasher_(item);
+    IndexTagFromHash(hasher_(item), index, tag);
+  }
+
+  inline void IndexTagFromHash(const uint64_t hash, size_t *index,
+                               uint32_t *tag) const {
     *index = IndexHash(hash >> 32);
     *tag = TagHash(hash);
   }
 
+  // Only the low half of the tag counts, as stored in the short field of
+  // slots 0 and 2, so an entry kicked out of those is moved on without
+  // looking up its item.
   inline size_t AltIndex(const size_t index, const uint32_t tag) const {
-    return IndexHash((uint32_t)(index ^ (tag * 0x5bd1e995)));
+    uint32_t tagshort = tag & ((1ULL << bits_per_item) - 1);
+    tagshort += (tagshort == 0);
+    return IndexHash((uint32_t)(index ^ (tagshort * 0x5bd1e995)));
+  }
+
+  Status AddImpl(const size_t i, const uint32_t tag, const uint64_t item);
+
+  // Put an entry into bucket i or its alternate bucket, shifting entries
+  // along a cuckoo path if both are full. Every entry stays in one of its
+  // buckets throughout, as concurrent readers need. num_items_ is left to
+  // the caller.
+  bool AddToTable(const size_t i, const uint32_t tag, const uint64_t item);
+
+  inline bool InsertToBucket(const size_t i, const uint32_t tag,
+                             const uint64_t item) {
+    uint32_t oldtag;
+    uint64_t olditem;
+    StripeWriteGuard guard(seqlock_, StripedSeqLock::Stripe(i),
+                           StripedSeqLock::Stripe(i));
+    return table_->InsertTagToBucket(i, tag, false, oldtag, item, olditem);
+  }
+
+  inline void WriteSlot(const size_t i, const size_t j, const uint32_t tag,
+                        const uint64_t item) {
+    StripeWriteGuard guard(seqlock_, StripedSeqLock::Stripe(i),
+                           StripedSeqLock::Stripe(i));
+    table_->WriteSlot(i, j, tag, item);
+  }
+
+  inline bool DeleteFromBucket(const size_t i, const uint32_t tag,
+                               const bool exact, const uint64_t item) {
+    StripeWriteGuard guard(seqlock_, StripedSeqLock::Stripe(i),
+                           StripedSeqLock::Stripe(i));
+    return table_->DeleteEntryFromBucket(i, tag, exact, item);
+  }
+
+  inline void SetVictim(const size_t i, const uint32_t tag,
+                        const uint64_t item, const bool used) {
+    StripeWriteGuard guard(seqlock_, StripedSeqLock::kVictimStripe,
+                           StripedSeqLock::kVictimStripe);
+    RelaxedStore(&victim_.index, i);
+    RelaxedStore(&victim_.tag, tag);
+    RelaxedStore(&victim_.item, item);
+    RelaxedStore(&victim_.used, used);
+  }
+
+  // the victim as a reader of a concurrent filter sees it, see seqlock.h
+  VictimCache LoadVictim() const {
+    VictimCache v;
+    v.index = RelaxedLoad(&victim_.index);
+    v.tag = RelaxedLoad(&victim_.tag);
+    v.item = RelaxedLoad(&victim_.item);
+    v.used = RelaxedLoad(&victim_.used);
+    return v;
+  }
+
+  // the writer lock in concurrent mode, none otherwise
+  std::unique_lock<std::mutex> LockWriter() {
+    return seqlock_ != NULL ? std::unique_lock<std::mutex>(seqlock_->writer)
+                            : std::unique_lock<std::mutex>();
   }
 
-  Status AddImpl(const size_t i, const uint32_t tag, const ItemType &item);
+  // Place an entry whose buckets i1 and i2 are both full by shifting the
+  // entries along the shortest cuckoo path. The table keeps only a half of
+  // each tag in a full bucket, so the tags along the path are rehashed from
+  // the items. False if no path was found within kMaxPathSearchBuckets
+  // buckets, the table is left as it was.
+  bool AddByPathSearch(const size_t i1, const size_t i2, const uint32_t tag,
+                       const uint64_t item);
+
+  inline bool OnPath(const PathNode *path, int n, const size_t bucket) const {
+    for (; n >= 0; n = path[n].parent) {
+      if (path[n].bucket == bucket) {
+        return true;
+      }
+    }
+    return false;
+  }
 
   /**
    * @brief
@@ -72,45 +193,339 @@ class CuckooFilterChangeFLength {
    * @return Status
    */
   Status AddImplWithFN(const size_t i, const uint32_t tag,
-                       const size_t var_kMaxCuckooCount, const ItemType &item);
+                       const size_t var_kMaxCuckooCount, const uint64_t item);
 
-  double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
-  double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
+  double BitsPerItem() const { return 8.0 * SizeInBytes() / Size(); }
+
+  // index i of table_ maps to i & (old buckets - 1) in the old table, as
+  // both tables use the low bits of the same hash
+  inline bool OldTableHasBuckets(const size_t i1, const size_t i2) const {
+    return old_table_ != NULL && (!migrated_[i1] || !migrated_[i2]);
+  }
+
+  bool MigrateBucket(const size_t i);
+
+  // DeleteHash(), of the entry of item only if exact
+  Status DeleteImpl(const uint64_t hash, const bool exact,
+                    const uint64_t item);
+
+  // ChangeFingerprintHash() with the writer lock held
+  Status ChangeFingerprintLocked(const uint64_t hash);
+
+  // true if a header read by Deserialize() or Map() was written by a
+  // filter with the same template parameters
+  bool HeaderMatches(const FilterHeader &header) const;
+
+  // replace table_, unmapping the file it was a view of
+  void ResetTable(TableType<bits_per_item> *table);
+
+  // let table recompute the tags of the items it moves with hasher_
+  void UseHasher(TableType<bits_per_item> *table) {
+    table->SetHasher([this](const uint64_t item) { return hasher_(item); });
+  }
+
+  // a table of num_buckets buckets that hashes with hasher_, or NULL if
+  // there is no memory for it
+  TableType<bits_per_item> *NewTable(const size_t num_buckets) {
+    TableType<bits_per_item> *table;
+    try {
+      table = new TableType<bits_per_item>(num_buckets, store_options_);
+    } catch (const std::bad_alloc &) {
+      return NULL;
+    }
+    UseHasher(table);
+    return table;
+  }
 
  public:
-  explicit CuckooFilterChangeFLength(const size_t max_num_keys)
-      : num_items_(0), victim_(), hasher_() {
+  typedef ItemType Item;
+  typedef HashFamily Hasher;
+  typedef typename TableType<bits_per_item>::StoreOptions StoreOptions;
+
+  // The table gets the smallest power-of-two number of buckets that holds
+  // max_num_keys at kTargetLoadFactor. A positive bits_per_key caps the
+  // memory of the table, the bucket array and what the item store keeps in
+  // memory, at bits_per_key * max_num_keys bits; with 12-bit tags a full
+  // table takes 80 bits a key with KeyStore and 40 with TagStore. A budget
+  // too small for max_num_keys is not refused: the table is cut to fit and
+  // Capacity() is then below max_num_keys. The filter hashes with a copy of
+  // hasher, randomly seeded by default; Serialize() writes it out with the
+  // filter. Every table it makes, here or on Grow or Deserialize, gets
+  // store_options for its item store, e.g. the Source of a CallbackStore.
+  // Throws std::bad_alloc if there is no memory for the table.
+  explicit CuckooFilterChangeFLength(
+      const size_t max_num_keys, const double bits_per_key = 0,
+      const HashFamily &hasher = HashFamily(),
+      const StoreOptions &store_options = StoreOptions())
+      : num_items_(0),
+        victim_(),
+        hasher_(hasher),
+        store_options_(store_options),
+        insert_mode_(RandomWalk),
+        grow_load_factor_(0),
+        old_table_(NULL),
+        migrate_pos_(0),
+        grow_step_(0),
+        mapping_(NULL),
+        mapping_size_(0),
+        seqlock_(NULL) {
     size_t assoc = 4;
-    size_t num_buckets = 8192;
-    double frac = (double)max_num_keys / num_buckets / assoc;
-    if (frac > 0.96) {
-      std::cout << "CF might fail." << std::endl;
+    size_t num_buckets = upperpower2(std::max<uint64_t>(
+        1, ceil(max_num_keys / kTargetLoadFactor / assoc)));
+    if (bits_per_key > 0) {
+      while (num_buckets > 1 &&
+             num_buckets * TableType<bits_per_item>::BitsPerBucket() >
+                 bits_per_key * max_num_keys) {
+        num_buckets >>= 1;
+      }
     }
     victim_.used = false;
-    table_ = new TableType<bits_per_item>(num_buckets);
+    table_ = new TableType<bits_per_item>(num_buckets, store_options_);
+    UseHasher(table_);
   }
 
-  ~CuckooFilterChangeFLength() { delete table_; }
+  ~CuckooFilterChangeFLength() {
+    ResetTable(NULL);
+    delete old_table_;
+    delete seqlock_;
+  }
 
   // Add an item to the filter.
   Status Add(const ItemType &item);
 
+  // Add() of a key whose KeyDigest() and its HashDigest() are known.
+  // NotSupported if the digest is wider than the keys of the item store,
+  // see SingleTableWithKeys.
+  Status AddHash(const uint64_t item, const uint64_t hash);
+
+  // RandomWalk by default. PathSearch reaches a higher load factor before
+  // the first failure and keeps the kick chains short near full occupancy.
+  void SetInsertMode(const InsertMode mode) { insert_mode_ = mode; }
+
+  // In concurrent mode the filter takes one writer at a time and any
+  // number of readers alongside it, without a lock on the read side.
+  // Contain, ContainBatch and ContainHash probe optimistically and read
+  // again if a bucket they looked at was written meanwhile, see seqlock.h.
+  // Add, AddWithFN, Delete and ChangeFingerprint serialize on a writer
+  // lock and mark the stripes of the buckets they write. Inserts always
+  // use PathSearch, as a random walk holds an evicted entry outside of the
+  // table where readers would miss it; when no path is found the new item
+  // goes to the victim cache. Growing and BulkBuild return NotSupported
+  // and auto-grow is off; the rest, e.g. Serialize or Map, must not
+  // overlap any other call.
+  // NotSupported during an incremental grow. Not thread-safe itself.
+  Status SetConcurrent(const bool on) {
+    if (old_table_ != NULL) {
+      return NotSupported;
+    }
+    if (!on) {
+      delete seqlock_;
+      seqlock_ = NULL;
+    } else if (seqlock_ == NULL) {
+      seqlock_ = new StripedSeqLock();
+    }
+    return Ok;
+  }
+
+  bool Concurrent() const { return seqlock_ != NULL; }
+
+  // Add n keys at once. They are hashed on `threads` threads (0: one per
+  // core), ordered by the block of buckets their primary bucket is in, and
+  // every thread fills its own blocks, so the table is written mostly in
+  // cache. Keys whose primary bucket is full are added with cuckoo kicks
+  // afterwards on this thread. NotEnoughSpace if the filter filled up
+  // before all keys were in, NotSupported without adding any if a key is
+  // wider than the keys of the item store.
+  Status BulkBuild(const ItemType *keys, const size_t n,
+                   const unsigned threads = 0);
+
   // Add an item to the filter.
   Status AddWithFN(const ItemType &item, const size_t var_kMaxCuckooCount = 16);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain() without false positives: a fingerprint hit is confirmed
+  // against the item stored with it, which is the key itself for integer
+  // keys and its 64-bit digest otherwise. Only hits read the item store.
+  // NotSupported on a mapped view without items and on a table that keeps
+  // tags only, e.g. SingleTableWithTags.
+  Status ContainExact(const ItemType &item) const;
+  Status ContainExactHash(const uint64_t item, const uint64_t hash) const;
+
+  // Contain() for n keys: a window of keys is hashed and both candidate
+  // buckets of each are prefetched before any of them is probed, so their
+  // cache misses overlap. out[k] receives the Status of keys[k].
+  void ContainBatch(const ItemType *keys, const size_t n, uint8_t *out) const;
+
+  // Contain() for an item whose hash has already been computed by Hash(),
+  // so that filters sharing a HashFamily hash each key only once. Add,
+  // Delete and ChangeFingerprint have such variants as well.
+  Status ContainHash(const uint64_t hash) const;
+
+  uint64_t Digest(const ItemType &item) const {
+    return KeyDigest(item, hasher_);
+  }
+  uint64_t Hash(const ItemType &item) const { return hasher_(Digest(item)); }
+  uint64_t HashDigest(const uint64_t digest) const { return hasher_(digest); }
+
   Status ChangeFingerprint(const ItemType &item);
-  // Delete an key from the filter
+  Status ChangeFingerprintHash(const uint64_t hash);
+
+  // ChangeFingerprintHash() of n hashes from Hash() under one writer lock,
+  // applied in bucket order; hashes is sorted in place. Returns the number
+  // of keys whose fingerprint changed, 0 on a mapped view.
+  size_t ChangeFingerprintHashBatch(uint64_t *hashes, const size_t n);
+
+  // Where ContainProbe() found a key, for AdaptAt(). Only good until the
+  // next Add, Delete, ChangeFingerprint, AdaptAt or grow step; AdaptAt()
+  // checks the slot again and returns NotFound for a stale one.
+  class ProbeHandle {
+    friend class CuckooFilterChangeFLength;
+    const TableType<bits_per_item> *table_;
+    size_t bucket_;
+    size_t slot_;
+    uint32_t tag_;
+
+   public:
+    ProbeHandle() : table_(NULL), bucket_(0), slot_(kTagsPerBucket), tag_(0) {}
+  };
+
+  // Contain() that also records in handle the slot ChangeFingerprint()
+  // would change. AdaptAt(handle) then changes it without hashing the key
+  // or probing its buckets again, for the hot loop of
+  //   if (ContainProbe(k, &h) == Ok && !backend.Has(k)) AdaptAt(h);
+  // A hit on a long tag or the victim cache leaves nothing to adapt.
+  Status ContainProbe(const ItemType &item, ProbeHandle *handle) const;
+  Status ContainProbeHash(const uint64_t hash, ProbeHandle *handle) const;
+
+  // ChangeFingerprint() of the slot recorded by ContainProbe(). NotFound
+  // if there is none or it no longer holds the tag.
+  Status AdaptAt(const ProbeHandle &handle);
+
+  // The above in one call: Ok if the key hits and is_absent(item) says it
+  // was a false positive, after which it is adapted and NotFound returned.
+  template <typename IsAbsent>
+  Status ContainOrAdapt(const ItemType &item, IsAbsent is_absent) {
+    ProbeHandle handle;
+    if (ContainProbe(item, &handle) != Ok) {
+      return NotFound;
+    }
+    if (!is_absent(item)) {
+      return Ok;
+    }
+    AdaptAt(handle);
+    return NotFound;
+  }
+  // Delete an key from the filter. With an item store of keys only the
+  // entry of the key itself goes, so deleting a key that was never added
+  // returns NotFound even where its tag matches another entry; each hit
+  // reads the item store. DeleteHash() has just the tag to go by, and
+  // DeleteExactHash() is Delete() for a digest and hash from Digest() and
+  // HashDigest().
   Status Delete(const ItemType &item);
+  Status DeleteHash(const uint64_t hash);
+  Status DeleteExactHash(const uint64_t item, const uint64_t hash);
+
+  // Double the number of buckets and re-insert every item from the item
+  // store. On failure the filter is left as it was: NotEnoughSpace if the
+  // bigger table fills up or cannot be allocated, NotSupported on a table
+  // that keeps tags only or whose keys the caller keeps, as is StartGrow().
+  Status Grow();
+
+  // Let Add() call Grow() once the load factor reaches max_load_factor, or
+  // when an insertion runs out of cuckoo kicks. 0 turns auto-grow off.
+  void SetAutoGrow(const double max_load_factor) {
+    grow_load_factor_ = max_load_factor;
+  }
+
+  // Switch to a table with twice the buckets without rehashing everything
+  // at once: the old table stays readable and its buckets are moved over by
+  // later calls to MigrateBuckets(). NotEnoughSpace if there is no memory
+  // for the new table.
+  Status StartGrow();
+
+  // Move up to n buckets of an incremental grow into the new table, from
+  // a background tick or from the mutations themselves. Returns the number
+  // of buckets still left to move. Once the new table fills up and an item
+  // waits in the victim cache, the rest is moved at once by Grow(), into a
+  // table twice as big again.
+  size_t MigrateBuckets(const size_t n);
+
+  // Make auto-grow incremental, moving buckets_per_mutation buckets on each
+  // Add, Delete and ChangeFingerprint. 0 goes back to a one-shot Grow().
+  void SetIncrementalGrow(const size_t buckets_per_mutation) {
+    grow_step_ = buckets_per_mutation;
+  }
+
+  bool Growing() const { return old_table_ != NULL; }
+
+  // Append every item held by the filter to items, e.g. to rebuild it.
+  // These are the KeyDigest() of the keys, to be added back by AddHash().
+  // Nothing for a table that keeps tags only.
+  void ExportItems(std::vector<uint64_t> *items) const;
+
+  // Write the filter to out in the format of filterformat.h: the template
+  // and hash parameters, the victim and the item count, then the bucket
+  // array and the item store. Settings such as auto-grow are not part of
+  // it. Without with_items the item store is left out, for a file that is
+  // only ever mapped by Map(). NotSupported during an incremental grow,
+  // finish it first, or with_items on a filter without item store or
+  // whose store StoreFailed(), and NotEnoughSpace if out fails, e.g. on a
+  // full disk.
+  Status Serialize(std::ostream &out, const bool with_items = true) const;
+
+  // Replace the filter with one written by Serialize() with its item
+  // store. InvalidFormat if in does not hold such a filter, it was written
+  // with other template parameters, a section fails its checksum or the
+  // new item store fails, NotEnoughSpace if there is no memory for the
+  // table; the filter is unchanged then. NotSupported during an
+  // incremental grow.
+  Status Deserialize(std::istream &in);
+
+  // Replace the filter with a read-only view of a file written by
+  // Serialize(): the buckets are probed where they lie in a shared mapping
+  // of the file, so it loads in constant time and processes mapping the
+  // same file share its pages. with_items also attaches the item store,
+  // which only ExportItems() and Serialize() read; without it, or if the
+  // file has none, ExportItems() yields just the victim. verify checks the
+  // checksums of the sections used, which reads them all once; the header
+  // is always checked. Add, Delete, ChangeFingerprint and growing return
+  // NotSupported on the view. InvalidFormat as in Deserialize(), also if
+  // the file cannot be mapped, and the filter is unchanged then.
+  Status Map(const char *path, const bool with_items = false,
+             const bool verify = false);
+
+  bool ReadOnly() const { return mapping_ != NULL; }
+
+  // whether the item store holds the keys, which ContainExact, growing and
+  // ExportItems need
+  bool HasKeys() const { return table_->HasKeys(); }
+  // whether the items can be moved to another table, as Grow() does
+  bool CanGrow() const { return table_->CanGrow(); }
+  // whether the item store has lost data, e.g. to an I/O error of a
+  // FileStore: from then on the calls that use it return NotSupported
+  bool StoreFailed() const {
+    return table_->ItemsFailed() ||
+           (old_table_ != NULL && old_table_->ItemsFailed());
+  }
 
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
 
   size_t Size() const { return num_items_; }
-  size_t SizeInBytes() const { return table_->SizeInBytes(); }
+  // the number of keys the table holds at kTargetLoadFactor; below the
+  // max_num_keys of the ctor when bits_per_key cut the table
+  size_t Capacity() const {
+    return table_->SizeInTags() * kTargetLoadFactor;
+  }
+  // load factor is the fraction of occupancy
+  double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
+  size_t SizeInBytes() const {
+    return table_->SizeInBytes() +
+           (old_table_ != NULL ? old_table_->SizeInBytes() : 0);
+  }
   size_t SBucketInfo(int i) const { return table_->BucketInfo(i); }
 };
 
@@ -118,24 +533,111 @@ template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
                                  HashFamily>::Add(const ItemType &item) {
+  const uint64_t digest = KeyDigest(item, hasher_);
+  return AddHash(digest, hasher_(digest));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::AddHash(const uint64_t item,
+                                                      const uint64_t hash) {
   size_t i;
   uint32_t tag;
 
+  if (mapping_ != NULL || StoreFailed() || !table_->Fits(item)) {
+    return NotSupported;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  if (grow_load_factor_ > 0 && seqlock_ == NULL &&
+      (victim_.used || LoadFactor() >= grow_load_factor_)) {
+    if (old_table_ == NULL && grow_step_ > 0) {
+      StartGrow();
+    } else if (old_table_ == NULL || victim_.used) {
+      Grow();
+    }
+  }
+
+  // the victim cache holds an item already, the filter is full
   if (victim_.used) {
-    std::cout << std::string(80, '=') << std::endl;
-    if (Contain(item) == Ok) {
-      std::cout << "Item was already in the set." << std::endl;
-    } else {
-      std::cout << "Item was not already in the set." << std::endl;
+    return NotEnoughSpace;
+  }
+
+  IndexTagFromHash(hash, &i, &tag);
+  Status status = AddImpl(i, tag, item);
+  if (old_table_ != NULL) {
+    MigrateBuckets(grow_step_);
+  }
+  return status;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::BulkBuild(const ItemType *keys, const size_t n,
+                           const unsigned threads) {
+  std::vector<BulkEntry> overflow;
+
+  if (mapping_ != NULL || seqlock_ != NULL || StoreFailed()) {
+    return NotSupported;
+  }
+  for (size_t k = 0; table_->KeyBits() < 64 && k < n; k++) {
+    if (!table_->Fits(KeyDigest(keys[k], hasher_))) {
+      return NotSupported;
     }
-    std::cout << "Info: ";
-    std::cout << Info();
-    std::cout << std::string(80, '=') << std::endl;
+  }
+  if (old_table_ != NULL) {
+    MigrateBuckets(old_table_->NumBuckets());
+  }
+  if (victim_.used || old_table_ != NULL) {
     return NotEnoughSpace;
   }
+  // with auto-grow, grow up front instead of once per doubling
+  while (grow_load_factor_ > 0 &&
+         Size() + n >= grow_load_factor_ * table_->SizeInTags()) {
+    if (Grow() != Ok) {
+      break;
+    }
+  }
 
-  GenerateIndexTagHash(item, &i, &tag);
-  return AddImpl(i, tag, item);
+  // InsertTagToBucket only writes the bytes of its own bucket
+  num_items_ += PartitionedPlace(
+      n, table_->NumBuckets(), threads,
+      [&](const size_t k, BulkEntry *entry) {
+        size_t index;
+        entry->item = KeyDigest(keys[k], hasher_);
+        GenerateIndexTagHash(entry->item, &index, &entry->tag);
+        entry->index = index;
+      },
+      [&](const size_t index, const uint32_t tag) {
+        return AltIndex(index, tag);
+      },
+      [&](const BulkEntry &entry) {
+        uint32_t oldtag;
+        uint64_t olditem;
+        return table_->InsertTagToBucket(entry.index, entry.tag, false,
+                                         oldtag, entry.item, olditem);
+      },
+      &overflow);
+
+  // both buckets of these are full, so search for short cuckoo paths
+  const InsertMode mode = insert_mode_;
+  insert_mode_ = PathSearch;
+  Status status = Ok;
+  for (size_t o = 0; o < overflow.size() && status == Ok; o++) {
+    if (victim_.used && (grow_load_factor_ == 0 || Grow() != Ok)) {
+      status = NotEnoughSpace;
+    } else {
+      // a Grow() above moved everything, so hash the key again
+      size_t i;
+      uint32_t tag;
+      GenerateIndexTagHash(overflow[o].item, &i, &tag);
+      AddImpl(i, tag, overflow[o].item);
+    }
+  }
+  insert_mode_ = mode;
+  return status;
 }
 
 template <typename ItemType, size_t bits_per_item,
@@ -147,8 +649,16 @@ Status CuckooFilterChangeFLength<
   size_t i;
   uint32_t tag;
 
-  GenerateIndexTagHash(item, &i, &tag);
-  return AddImpl(i, tag, item);
+  if (mapping_ != NULL || StoreFailed()) {
+    return NotSupported;
+  }
+  const uint64_t digest = KeyDigest(item, hasher_);
+  if (!table_->Fits(digest)) {
+    return NotSupported;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  GenerateIndexTagHash(digest, &i, &tag);
+  return AddImpl(i, tag, digest);
 }
 
 template <typename ItemType, size_t bits_per_item,
@@ -156,14 +666,25 @@ template <typename ItemType, size_t bits_per_item,
 Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
                                  HashFamily>::AddImpl(const size_t i,
                                                       const uint32_t tag,
-                                                      const ItemType &item) {
+                                                      const uint64_t item) {
   size_t curindex = i;
-  size_t curindexnomeans;
   uint32_t curtag = tag;
   uint32_t oldtag;
   uint64_t curitem = item;
   uint64_t olditem;
 
+  if (insert_mode_ == PathSearch || seqlock_ != NULL) {
+    if (AddToTable(i, tag, item)) {
+      num_items_++;
+      return Ok;
+    }
+    if (seqlock_ != NULL) {
+      SetVictim(i, tag, item, true);
+      return Ok;
+    }
+    // no short path, the random walk below ends in the victim cache
+  }
+
   for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
     bool kickout = count > 0;
     oldtag = 0;
@@ -175,24 +696,105 @@ Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
     }
     if (kickout) {
       curitem = olditem;
-      GenerateIndexTagHash(curitem, &curindexnomeans, &curtag);
+      curtag = oldtag;
     }
     curindex = AltIndex(curindex, curtag);
+    // the kicked entry may have just the low half of its tag, which a full
+    // bucket can take; it needs the whole tag only where it lands
+    if (kickout && table_->NumTagsInBucket(curindex) < kTagsPerBucket) {
+      curtag = table_->WholeTag(curtag, curitem);
+    }
   }
 
   victim_.index = curindex;
-  victim_.tag = curtag;
+  victim_.tag = table_->WholeTag(curtag, curitem);
+  victim_.item = curitem;
   victim_.used = true;
   return Ok;
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                               HashFamily>::AddToTable(const size_t i,
+                                                       const uint32_t tag,
+                                                       const uint64_t item) {
+  const size_t i2 = AltIndex(i, tag);
+  return InsertToBucket(i, tag, item) || InsertToBucket(i2, tag, item) ||
+         AddByPathSearch(i, i2, tag, item);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::AddByPathSearch(const size_t i1, const size_t i2,
+                                 const uint32_t tag, const uint64_t item) {
+  PathNode path[kMaxPathSearchBuckets];
+  // path[k].bucket, to load the items of a level of the search at once
+  size_t buckets[kMaxPathSearchBuckets];
+  uint64_t items[kTagsPerBucket];
+  uint32_t tags[kTagsPerBucket];
+  size_t alts[kTagsPerBucket];
+  size_t tail = 0;
+  size_t loaded = 0;
+
+  path[tail].bucket = buckets[tail] = i1;
+  path[tail].parent = -1;
+  tail++;
+  path[tail].bucket = buckets[tail] = i2;
+  path[tail].parent = -1;
+  tail++;
+
+  for (size_t head = 0; head < tail; head++) {
+    const size_t b = path[head].bucket;
+    if (head == loaded) {
+      table_->LoadItems(buckets + head, tail - head);
+      loaded = tail;
+    }
+    // start loading all alternate buckets before looking at any of them
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      items[j] = table_->ReadItem(b, j);
+      tags[j] = table_->TagOf(items[j]);
+      alts[j] = AltIndex(b, tags[j]);
+      table_->PrefetchBucket(alts[j]);
+    }
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (table_->NumTagsInBucket(alts[j]) < kTagsPerBucket) {
+        // Shift from the free end back to a root: each entry moves into
+        // the slot that its successor on the path has just left, so it is
+        // written to its new bucket before its old slot is overwritten.
+        InsertToBucket(alts[j], tags[j], items[j]);
+        int n = head;
+        size_t slot = j;
+        while (path[n].parent >= 0) {
+          const size_t from = path[path[n].parent].bucket;
+          const uint64_t moved = table_->ReadItem(from, path[n].slot);
+          WriteSlot(path[n].bucket, slot, table_->TagOf(moved), moved);
+          slot = path[n].slot;
+          n = path[n].parent;
+        }
+        WriteSlot(path[n].bucket, slot, tag, item);
+        return true;
+      }
+      if (tail < kMaxPathSearchBuckets && !OnPath(path, head, alts[j])) {
+        path[tail].bucket = buckets[tail] = alts[j];
+        path[tail].parent = head;
+        path[tail].slot = j;
+        tail++;
+      }
+    }
+  }
+  return false;
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterChangeFLength<
     ItemType, bits_per_item, TableType,
     HashFamily>::AddImplWithFN(const size_t i, const uint32_t tag,
                                const size_t var_kMaxCuckooCount,
-                               const ItemType &item) {
+                               const uint64_t item) {
   size_t curindex = i;
   uint32_t curtag = tag;
   uint32_t oldtag;
@@ -208,9 +810,13 @@ Status CuckooFilterChangeFLength<
       return Ok;
     }
     if (kickout) {
+      curitem = olditem;
       curtag = oldtag;
     }
     curindex = AltIndex(curindex, curtag);
+    if (kickout && table_->NumTagsInBucket(curindex) < kTagsPerBucket) {
+      curtag = table_->WholeTag(curtag, curitem);
+    }
   }
   return Ok;
 }
@@ -220,22 +826,150 @@ template <typename ItemType, size_t bits_per_item,
 Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
                                  HashFamily>::Contain(const ItemType &key)
     const {
+  return ContainHash(Hash(key));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::ContainHash(const uint64_t hash)
+    const {
   bool found = false;
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
   assert(i1 == AltIndex(i2, tag));
 
+  if (seqlock_ != NULL) {
+    const size_t s1 = StripedSeqLock::Stripe(i1);
+    const size_t s2 = StripedSeqLock::Stripe(i2);
+    const size_t sv = StripedSeqLock::kVictimStripe;
+    uint32_t v1, v2, vv;
+    do {
+      v1 = seqlock_->ReadBegin(s1);
+      v2 = seqlock_->ReadBegin(s2);
+      vv = seqlock_->ReadBegin(sv);
+      const VictimCache victim = LoadVictim();
+      found = (victim.used && (tag == victim.tag) &&
+               (i1 == victim.index || i2 == victim.index)) ||
+              table_->FindTagInBuckets(i1, i2, tag);
+    } while (seqlock_->ReadRetry(s1, v1) || seqlock_->ReadRetry(s2, v2) ||
+             seqlock_->ReadRetry(sv, vv));
+    return found ? Ok : NotFound;
+  }
+
   found = victim_.used && (tag == victim_.tag) &&
           (i1 == victim_.index || i2 == victim_.index);
 
   if (found || table_->FindTagInBuckets(i1, i2, tag)) {
     return Ok;
-  } else {
-    return NotFound;
+  }
+  if (old_table_ != NULL) {
+    const size_t mask = old_table_->NumBuckets() - 1;
+    i1 &= mask;
+    i2 &= mask;
+    if (OldTableHasBuckets(i1, i2) &&
+        old_table_->FindTagInBuckets(i1, i2, tag)) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::ContainExact(const ItemType &key)
+    const {
+  const uint64_t digest = Digest(key);
+  return ContainExactHash(digest, hasher_(digest));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::ContainExactHash(const uint64_t item, const uint64_t hash)
+    const {
+  bool found = false;
+  size_t i1, i2;
+  uint32_t tag;
+
+  if (!table_->HasKeys() || StoreFailed()) {
+    return NotSupported;
+  }
+  IndexTagFromHash(hash, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  if (seqlock_ != NULL) {
+    const size_t s1 = StripedSeqLock::Stripe(i1);
+    const size_t s2 = StripedSeqLock::Stripe(i2);
+    const size_t sv = StripedSeqLock::kVictimStripe;
+    uint32_t v1, v2, vv;
+    do {
+      v1 = seqlock_->ReadBegin(s1);
+      v2 = seqlock_->ReadBegin(s2);
+      vv = seqlock_->ReadBegin(sv);
+      const VictimCache victim = LoadVictim();
+      found = (victim.used && item == victim.item) ||
+              table_->FindItemInBuckets(i1, i2, tag, item);
+    } while (seqlock_->ReadRetry(s1, v1) || seqlock_->ReadRetry(s2, v2) ||
+             seqlock_->ReadRetry(sv, vv));
+    return found ? Ok : NotFound;
+  }
+
+  found = victim_.used && item == victim_.item;
+
+  if (found || table_->FindItemInBuckets(i1, i2, tag, item)) {
+    return Ok;
+  }
+  if (old_table_ != NULL) {
+    const size_t mask = old_table_->NumBuckets() - 1;
+    i1 &= mask;
+    i2 &= mask;
+    if (OldTableHasBuckets(i1, i2) &&
+        old_table_->FindItemInBuckets(i1, i2, tag, item)) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilterChangeFLength<ItemType, bits_per_item, TableType, HashFamily>::
+    ContainBatch(const ItemType *keys, const size_t n, uint8_t *out) const {
+  uint64_t hash[kContainBatchWindow];
+  size_t i1[kContainBatchWindow], i2[kContainBatchWindow];
+  uint32_t tag[kContainBatchWindow];
+
+  for (size_t base = 0; base < n; base += kContainBatchWindow) {
+    const size_t m = std::min(kContainBatchWindow, n - base);
+    for (size_t k = 0; k < m; k++) {
+      hash[k] = Hash(keys[base + k]);
+      IndexTagFromHash(hash[k], &i1[k], &tag[k]);
+      i2[k] = AltIndex(i1[k], tag[k]);
+      table_->PrefetchBucket(i1[k]);
+      table_->PrefetchBucket(i2[k]);
+    }
+    for (size_t k = 0; k < m; k++) {
+      if (seqlock_ != NULL) {
+        out[base + k] = ContainHash(hash[k]);
+        continue;
+      }
+      bool found = victim_.used && (tag[k] == victim_.tag) &&
+                   (i1[k] == victim_.index || i2[k] == victim_.index);
+      if (found || table_->FindTagInBuckets(i1[k], i2[k], tag[k])) {
+        out[base + k] = Ok;
+      } else if (old_table_ != NULL) {
+        out[base + k] = ContainHash(hash[k]);
+      } else {
+        out[base + k] = NotFound;
+      }
+    }
   }
 }
 
@@ -244,54 +978,670 @@ template <typename ItemType, size_t bits_per_item,
 Status
 CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
                           HashFamily>::ChangeFingerprint(const ItemType &key) {
+  return ChangeFingerprintHash(Hash(key));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::ChangeFingerprintHash(const uint64_t hash) {
+  if (mapping_ != NULL || StoreFailed()) {
+    return NotSupported;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  return ChangeFingerprintLocked(hash);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+size_t CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::
+    ChangeFingerprintHashBatch(uint64_t *hashes, const size_t n) {
+  if (mapping_ != NULL || StoreFailed()) {
+    return 0;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  const size_t mask = table_->NumBuckets() - 1;
+  std::sort(hashes, hashes + n, [mask](const uint64_t a, const uint64_t b) {
+    return ((a >> 32) & mask) < ((b >> 32) & mask);
+  });
+  size_t changed = 0;
+  for (size_t k = 0; k < n; k++) {
+    changed += ChangeFingerprintLocked(hashes[k]) == Ok;
+  }
+  return changed;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::ChangeFingerprintLocked(const uint64_t hash) {
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
   assert(i1 == AltIndex(i2, tag));
 
-  if (table_->FindWrongTagInBuckets(i1, i2, tag)) {
-    return Ok;
+  Status status = NotFound;
+  bool changed;
+  {
+    StripeWriteGuard guard(seqlock_, StripedSeqLock::Stripe(i1),
+                           StripedSeqLock::Stripe(i2));
+    changed = table_->FindWrongTagInBuckets(i1, i2, tag);
+  }
+  if (changed) {
+    status = Ok;
+  } else if (old_table_ != NULL) {
+    const size_t mask = old_table_->NumBuckets() - 1;
+    i1 &= mask;
+    i2 &= mask;
+    if (OldTableHasBuckets(i1, i2) &&
+        old_table_->FindWrongTagInBuckets(i1, i2, tag)) {
+      status = Ok;
+    }
+  }
+  if (old_table_ != NULL) {
+    MigrateBuckets(grow_step_);
+  }
+  return status;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::ContainProbe(const ItemType &key, ProbeHandle *handle) const {
+  return ContainProbeHash(Hash(key), handle);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status
+CuckooFilterChangeFLength<ItemType, bits_per_item, TableType, HashFamily>::
+    ContainProbeHash(const uint64_t hash, ProbeHandle *handle) const {
+  const TableType<bits_per_item> *table = table_;
+  size_t i1, i2, bucket = 0, slot = kTagsPerBucket;
+  uint32_t tag;
+  bool found;
+
+  IndexTagFromHash(hash, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  if (seqlock_ != NULL) {
+    const size_t s1 = StripedSeqLock::Stripe(i1);
+    const size_t s2 = StripedSeqLock::Stripe(i2);
+    const size_t sv = StripedSeqLock::kVictimStripe;
+    uint32_t v1, v2, vv;
+    do {
+      v1 = seqlock_->ReadBegin(s1);
+      v2 = seqlock_->ReadBegin(s2);
+      vv = seqlock_->ReadBegin(sv);
+      const VictimCache victim = LoadVictim();
+      found = table_->FindTagSlotInBuckets(i1, i2, tag, &bucket, &slot) ||
+              (victim.used && (tag == victim.tag) &&
+               (i1 == victim.index || i2 == victim.index));
+    } while (seqlock_->ReadRetry(s1, v1) || seqlock_->ReadRetry(s2, v2) ||
+             seqlock_->ReadRetry(sv, vv));
   } else {
+    // a miss costs what it does in Contain(), the slot is only looked
+    // for once there is a hit
+    found = table_->FindTagInBuckets(i1, i2, tag) &&
+            table_->FindTagSlotInBuckets(i1, i2, tag, &bucket, &slot);
+    if (!found && old_table_ != NULL) {
+      const size_t mask = old_table_->NumBuckets() - 1;
+      if (OldTableHasBuckets(i1 & mask, i2 & mask) &&
+          old_table_->FindTagSlotInBuckets(i1 & mask, i2 & mask, tag, &bucket,
+                                           &slot)) {
+        table = old_table_;
+        found = true;
+      }
+    }
+    if (!found) {
+      found = victim_.used && (tag == victim_.tag) &&
+              (i1 == victim_.index || i2 == victim_.index);
+    }
+  }
+  // written once at the end, as the compiler cannot tell that handle
+  // does not alias the filter
+  handle->table_ = table;
+  handle->bucket_ = bucket;
+  handle->slot_ = slot;
+  handle->tag_ = tag;
+  return found ? Ok : NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::AdaptAt(const ProbeHandle &handle) {
+  if (mapping_ != NULL || StoreFailed()) {
+    return NotSupported;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  TableType<bits_per_item> *table = NULL;
+  if (handle.table_ == table_) {
+    table = table_;
+  } else if (handle.table_ == old_table_ && old_table_ != NULL &&
+             handle.bucket_ < old_table_->NumBuckets() &&
+             !migrated_[handle.bucket_]) {
+    table = old_table_;
+  }
+  if (table == NULL || handle.slot_ >= kTagsPerBucket) {
     return NotFound;
   }
+
+  bool changed;
+  {
+    const size_t s = StripedSeqLock::Stripe(handle.bucket_);
+    StripeWriteGuard guard(seqlock_, s, s);
+    changed = table->AdaptSlot(handle.bucket_, handle.slot_, handle.tag_);
+  }
+  if (old_table_ != NULL) {
+    MigrateBuckets(grow_step_);
+  }
+  return changed ? Ok : NotFound;
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
                                  HashFamily>::Delete(const ItemType &key) {
+  const uint64_t digest = Digest(key);
+  return DeleteExactHash(digest, hasher_(digest));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::DeleteExactHash(const uint64_t item, const uint64_t hash) {
+  return DeleteImpl(hash, table_->HasKeys(), item);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::DeleteHash(const uint64_t hash) {
+  return DeleteImpl(hash, false, 0);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<
+    ItemType, bits_per_item, TableType,
+    HashFamily>::DeleteImpl(const uint64_t hash, const bool exact,
+                            const uint64_t item) {
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  if (mapping_ != NULL || StoreFailed()) {
+    return NotSupported;
+  }
+  std::unique_lock<std::mutex> writer = LockWriter();
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
-  if (table_->DeleteTagFromBucket(i1, tag)) {
+  // a short tag can match another item in whichever table does not hold
+  // the key, so bring the key's old buckets over before deleting
+  if (old_table_ != NULL) {
+    const size_t mask = old_table_->NumBuckets() - 1;
+    MigrateBucket(i1 & mask);
+    MigrateBucket(i2 & mask);
+  }
+
+  if (DeleteFromBucket(i1, tag, exact, item)) {
     num_items_--;
     goto TryEliminateVictim;
-  } else if (table_->DeleteTagFromBucket(i2, tag)) {
+  } else if (DeleteFromBucket(i2, tag, exact, item)) {
     num_items_--;
     goto TryEliminateVictim;
   } else if (victim_.used && tag == victim_.tag &&
-             (i1 == victim_.index || i2 == victim_.index)) {
+             (i1 == victim_.index || i2 == victim_.index) &&
+             (!exact || item == victim_.item)) {
     // num_items_--;
-    victim_.used = false;
+    SetVictim(victim_.index, victim_.tag, victim_.item, false);
     return Ok;
-  } else {
-    return NotFound;
+  } else if (old_table_ != NULL) {
+    const size_t mask = old_table_->NumBuckets() - 1;
+    if (!migrated_[i1 & mask] &&
+        old_table_->DeleteEntryFromBucket(i1 & mask, tag, exact, item)) {
+      num_items_--;
+      goto TryEliminateVictim;
+    } else if (!migrated_[i2 & mask] &&
+               old_table_->DeleteEntryFromBucket(i2 & mask, tag, exact,
+                                                 item)) {
+      num_items_--;
+      goto TryEliminateVictim;
+    }
   }
+  return NotFound;
 TryEliminateVictim:
-  if (victim_.used) {
+  if (victim_.used && seqlock_ != NULL) {
+    // readers must find the victim in the table before it leaves the cache
+    if (AddToTable(victim_.index, victim_.tag, victim_.item)) {
+      num_items_++;
+      SetVictim(victim_.index, victim_.tag, victim_.item, false);
+    }
+  } else if (victim_.used) {
     victim_.used = false;
     size_t i = victim_.index;
     uint32_t tag = victim_.tag;
-    AddImpl(i, tag, key);
+    AddImpl(i, tag, victim_.item);
+  }
+  if (old_table_ != NULL) {
+    MigrateBuckets(grow_step_);
+  }
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::Grow() {
+  if (mapping_ != NULL || seqlock_ != NULL || !table_->CanGrow() ||
+      StoreFailed()) {
+    return NotSupported;
+  }
+  // an unfinished incremental grow contributes its unmoved buckets
+  TableType<bits_per_item> *sources[2] = {table_, old_table_};
+  const size_t starts[2] = {0, migrate_pos_};
+  const size_t old_num_items = num_items_;
+  const VictimCache old_victim = victim_;
+  uint64_t items[4];
+  size_t i;
+  uint32_t tag;
+
+  table_ = NewTable(sources[0]->NumBuckets() << 1);
+  if (table_ == NULL) {
+    table_ = sources[0];
+    return NotEnoughSpace;
+  }
+  num_items_ = 0;
+  victim_.used = false;
+
+  for (size_t t = 0; t < 2 && sources[t] != NULL; t++) {
+    for (size_t b = starts[t]; b < sources[t]->NumBuckets(); b++) {
+      size_t n = sources[t]->ReadItemsFromBucket(b, items);
+      if (t == 1 && migrated_[b]) {
+        continue;
+      }
+      for (size_t j = 0; j < n && !victim_.used; j++) {
+        GenerateIndexTagHash(items[j], &i, &tag);
+        AddImpl(i, tag, items[j]);
+      }
+    }
+  }
+  if (old_victim.used && !victim_.used) {
+    GenerateIndexTagHash(old_victim.item, &i, &tag);
+    AddImpl(i, tag, old_victim.item);
+  }
+
+  // a kick chain ran out inside the bigger table: keep the old one
+  if (victim_.used) {
+    delete table_;
+    table_ = sources[0];
+    num_items_ = old_num_items;
+    victim_ = old_victim;
+    return NotEnoughSpace;
+  }
+  delete sources[0];
+  delete sources[1];
+  old_table_ = NULL;
+  migrated_.clear();
+  migrate_pos_ = 0;
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::StartGrow() {
+  if (mapping_ != NULL || seqlock_ != NULL || !table_->CanGrow() ||
+      StoreFailed()) {
+    return NotSupported;
+  }
+  if (old_table_ != NULL) {
+    MigrateBuckets(old_table_->NumBuckets());
+    if (old_table_ != NULL) {
+      return NotEnoughSpace;
+    }
+  }
+  TableType<bits_per_item> *table = NewTable(table_->NumBuckets() << 1);
+  if (table == NULL) {
+    return NotEnoughSpace;
+  }
+  old_table_ = table_;
+  migrated_.assign(old_table_->NumBuckets(), false);
+  migrate_pos_ = 0;
+  table_ = table;
+
+  // the victim's index belongs to the old table, give it a real slot
+  if (victim_.used) {
+    size_t i;
+    uint32_t tag;
+    victim_.used = false;
+    GenerateIndexTagHash(victim_.item, &i, &tag);
+    AddImpl(i, tag, victim_.item);
   }
   return Ok;
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                               HashFamily>::MigrateBucket(const size_t b) {
+  uint64_t items[4];
+  uint32_t oldtag;
+  uint64_t olditem;
+  size_t i;
+  uint32_t tag;
+
+  if (migrated_[b]) {
+    return true;
+  }
+  // stop while a victim is pending, another failed kick chain would lose it
+  if (victim_.used) {
+    return false;
+  }
+  size_t count = old_table_->ReadItemsFromBucket(b, items);
+  old_table_->ClearBucket(b);
+  size_t j = 0;
+  for (; j < count && !victim_.used; j++) {
+    GenerateIndexTagHash(items[j], &i, &tag);
+    num_items_--;
+    AddImpl(i, tag, items[j]);
+  }
+  if (j < count) {
+    // put the rest back, the bucket is moved again once there is room
+    for (; j < count; j++) {
+      GenerateIndexTagHash(items[j], &i, &tag);
+      old_table_->InsertTagToBucket(b, tag, false, oldtag, items[j], olditem);
+    }
+    return false;
+  }
+  migrated_[b] = true;
+  return true;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+size_t CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::MigrateBuckets(const size_t n) {
+  if (old_table_ == NULL) {
+    return 0;
+  }
+  const size_t old_num_buckets = old_table_->NumBuckets();
+  const size_t end = std::min(old_num_buckets, migrate_pos_ + n);
+
+  while (migrate_pos_ < end && MigrateBucket(migrate_pos_)) {
+    migrate_pos_++;
+  }
+  // no bucket moves while a victim waits, and without auto-grow no Add()
+  // takes it out: finish in one go
+  if (migrate_pos_ < end && victim_.used && Grow() == Ok) {
+    return 0;
+  }
+
+  if (migrate_pos_ == old_num_buckets) {
+    delete old_table_;
+    old_table_ = NULL;
+    migrated_.clear();
+    migrate_pos_ = 0;
+    return 0;
+  }
+  return old_num_buckets - migrate_pos_;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilterChangeFLength<ItemType, bits_per_item, TableType, HashFamily>::
+    ExportItems(std::vector<uint64_t> *out) const {
+  uint64_t items[4];
+  size_t buckets[kExportBatch];
+  if (!table_->HoldsKeys()) {
+    return;
+  }
+  for (size_t b = 0; b < table_->NumBuckets() && table_->HasItems(); b++) {
+    if (b % kExportBatch == 0) {
+      const size_t n = (table_->NumBuckets() - b < kExportBatch)
+                           ? table_->NumBuckets() - b
+                           : kExportBatch;
+      for (size_t k = 0; k < n; k++) {
+        buckets[k] = b + k;
+      }
+      table_->LoadItems(buckets, n);
+    }
+    size_t n = table_->ReadItemsFromBucket(b, items);
+    out->insert(out->end(), items, items + n);
+  }
+  if (old_table_ != NULL) {
+    for (size_t b = migrate_pos_; b < old_table_->NumBuckets(); b++) {
+      if (!migrated_[b]) {
+        size_t n = old_table_->ReadItemsFromBucket(b, items);
+        out->insert(out->end(), items, items + n);
+      }
+    }
+  }
+  if (victim_.used) {
+    out->push_back(victim_.item);
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::Serialize(std::ostream &out,
+                                                        const bool with_items)
+    const {
+  static_assert(std::is_trivially_copyable<HashFamily>::value,
+                "the hash family is stored as raw bytes");
+  if (old_table_ != NULL ||
+      (with_items && (!table_->HasItems() || StoreFailed()))) {
+    return NotSupported;
+  }
+  const size_t item_bytes = with_items ? table_->ItemSizeInBytes() : 0;
+  // a FileStore is mapped until ReleaseItemData(), and may fail to be
+  const char *items = with_items ? table_->ItemData() : NULL;
+  if (with_items && StoreFailed()) {
+    table_->ReleaseItemData();
+    return NotSupported;
+  }
+  FilterHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kFilterMagic;
+  header.version = kFilterFormatVersion;
+  header.bits_per_item = bits_per_item;
+  header.item_size = sizeof(ItemType);
+  header.bucket_bytes = table_->SizeInBytes() / table_->NumBuckets();
+  header.item_bucket_bytes = item_bytes / table_->NumBuckets();
+  header.hasher_size = sizeof(HashFamily);
+  header.victim_used = victim_.used;
+  header.store_keys = table_->HoldsKeys();
+  header.key_bits = table_->KeyBits();
+  header.num_buckets = table_->NumBuckets();
+  header.num_items = num_items_;
+  header.victim_index = victim_.index;
+  header.victim_item = victim_.item;
+  header.victim_tag = victim_.tag;
+
+  std::string head(reinterpret_cast<const char *>(&header), sizeof(header));
+  head.append(reinterpret_cast<const char *>(&hasher_), sizeof(hasher_));
+  uint32_t checksum = 0;
+  WriteSection(out, head.data(), head.size(), &checksum);
+  WriteSection(out, table_->BucketData(), table_->SizeInBytes(), &checksum);
+  WriteSection(out, items, item_bytes, &checksum);
+  table_->ReleaseItemData();
+  return out ? Ok : NotEnoughSpace;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::Deserialize(std::istream &in) {
+  if (old_table_ != NULL) {
+    return NotSupported;
+  }
+  char head[sizeof(FilterHeader) + sizeof(HashFamily)];
+  FilterHeader header;
+  uint32_t checksum = 0;
+  if (!ReadSection(in, head, sizeof(head), &checksum)) {
+    return InvalidFormat;
+  }
+  memcpy(&header, head, sizeof(header));
+  if (!HeaderMatches(header)) {
+    return InvalidFormat;
+  }
+
+  TableType<bits_per_item> *table = NewTable(header.num_buckets);
+  if (table == NULL) {
+    return NotEnoughSpace;
+  }
+  bool valid = header.bucket_bytes * header.num_buckets ==
+                   table->SizeInBytes() &&
+               header.item_bucket_bytes * header.num_buckets ==
+                   table->ItemSizeInBytes() &&
+               ReadSection(in, table->BucketData(), table->SizeInBytes(),
+                           &checksum);
+  if (valid) {
+    char *items = table->ItemData();
+    valid = !table->ItemsFailed() &&
+            ReadSection(in, items, table->ItemSizeInBytes(), &checksum);
+    table->ReleaseItemData();
+  }
+  if (!valid) {
+    delete table;
+    return InvalidFormat;
+  }
+
+  ResetTable(table);
+  memcpy(&hasher_, head + sizeof(header), sizeof(hasher_));
+  num_items_ = header.num_items;
+  victim_.used = header.victim_used;
+  victim_.index = header.victim_index;
+  victim_.item = header.victim_item;
+  victim_.tag = header.victim_tag;
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                 HashFamily>::Map(const char *path,
+                                                  const bool with_items,
+                                                  const bool verify) {
+  if (old_table_ != NULL) {
+    return NotSupported;
+  }
+  size_t size;
+  char *data = MapFile(path, &size);
+  if (data == NULL) {
+    return InvalidFormat;
+  }
+
+  const size_t head_size = sizeof(FilterHeader) + sizeof(HashFamily);
+  FilterHeader header;
+  uint32_t checksum = 0;
+  uint32_t stored;
+  TableType<bits_per_item> *table = NULL;
+  if (size < head_size + sizeof(checksum)) {
+    goto Invalid;
+  }
+  memcpy(&header, data, sizeof(header));
+  checksum = HashUtil::MurmurHash(data, head_size, checksum);
+  memcpy(&stored, data + head_size, sizeof(stored));
+  if (stored != checksum || !HeaderMatches(header) ||
+      header.bucket_bytes == 0 ||
+      header.num_buckets >
+          size / (header.bucket_bytes + header.item_bucket_bytes) ||
+      size != head_size + 3 * sizeof(checksum) +
+                  header.num_buckets *
+                      (header.bucket_bytes + header.item_bucket_bytes)) {
+    goto Invalid;
+  }
+  {
+    char *buckets = data + head_size + sizeof(checksum);
+    char *items = buckets + header.num_buckets * header.bucket_bytes +
+                  sizeof(checksum);
+    const bool attach = with_items && header.item_bucket_bytes > 0;
+    table = new TableType<bits_per_item>(header.num_buckets, buckets,
+                                         attach ? items : NULL,
+                                         store_options_);
+    if (header.bucket_bytes * header.num_buckets != table->SizeInBytes() ||
+        (attach && header.item_bucket_bytes * header.num_buckets !=
+                       table->ItemSizeInBytes()) ||
+        table->ItemsFailed()) {
+      goto Invalid;
+    }
+    if (verify) {
+      const size_t item_bytes = header.item_bucket_bytes * header.num_buckets;
+      checksum = HashUtil::MurmurHash(buckets, table->SizeInBytes(), checksum);
+      memcpy(&stored, items - sizeof(stored), sizeof(stored));
+      if (stored != checksum) {
+        goto Invalid;
+      }
+      if (attach) {
+        checksum = HashUtil::MurmurHash(items, item_bytes, checksum);
+        memcpy(&stored, items + item_bytes, sizeof(stored));
+        if (stored != checksum) {
+          goto Invalid;
+        }
+      }
+    }
+  }
+
+  ResetTable(table);
+  mapping_ = data;
+  mapping_size_ = size;
+  memcpy(&hasher_, data + sizeof(header), sizeof(hasher_));
+  num_items_ = header.num_items;
+  victim_.used = header.victim_used;
+  victim_.index = header.victim_index;
+  victim_.item = header.victim_item;
+  victim_.tag = header.victim_tag;
+  return Ok;
+Invalid:
+  delete table;
+  UnmapFile(data, size);
+  return InvalidFormat;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                               HashFamily>::HeaderMatches(const FilterHeader
+                                                              &header) const {
+  return header.magic == kFilterMagic &&
+         header.version == kFilterFormatVersion &&
+         header.bits_per_item == bits_per_item &&
+         header.item_size == sizeof(ItemType) &&
+         header.hasher_size == sizeof(HashFamily) && header.num_buckets != 0 &&
+         (header.num_buckets & (header.num_buckets - 1)) == 0 &&
+         (header.item_bucket_bytes == 0 ||
+          (header.store_keys == TableType<bits_per_item>::HoldsKeys() &&
+           header.key_bits == TableType<bits_per_item>::KeyBits()));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                               HashFamily>::ResetTable(TableType<bits_per_item>
+                                                           *table) {
+  delete table_;
+  table_ = table;
+  if (table_ != NULL) {
+    UseHasher(table_);
+  }
+  if (mapping_ != NULL) {
+    UnmapFile(mapping_, mapping_size_);
+    mapping_ = NULL;
+    mapping_size_ = 0;
+  }
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 std::string CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
@@ -301,7 +1651,9 @@ std::string CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
      << "\t\t" << table_->Info() << "\n"
      << "\t\tKeys stored: " << Size() << "\n"
      << "\t\tLoad factor: " << LoadFactor() << "\n"
-     << "\t\tHashtable size: " << (table_->SizeInBytes() >> 10) << " KB\n";
+     << "\t\tHashtable size: " << (table_->SizeInBytes() >> 10) << " KB\n"
+     << "\t\tItem store size: " << (table_->ItemSizeInBytes() >> 10)
+     << " KB\n";
   if (Size() > 0) {
     ss << "\t\tbit/key:   " << BitsPerItem() << "\n";
   } else {
@@ -0,0 +1,104 @@
+#ifndef CUCKOO_FILTER_FILTER_FORMAT_H_
+#define CUCKOO_FILTER_FILTER_FORMAT_H_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <istream>
+#include <ostream>
+
+#include "hashutil.h"
+
+namespace cuckoofilter {
+
+// Layout of a serialized filter, all in host byte order:
+//
+//   FilterHeader
+//   hasher_size bytes      the HashFamily object, i.e. its seeded parameters
+//   uint32_t               checksum of the two above, seed 0
+//   bucket array           num_buckets * bucket_bytes bytes
+//   uint32_t               checksum of the bucket array
+//   item store             num_buckets * item_bucket_bytes bytes
+//   uint32_t               checksum of the item store
+//
+// Each checksum is a MurmurHash seeded with the one before it, so sections
+// that are swapped or come from different files do not verify either.
+// A filter written without its item store has item_bucket_bytes 0; it can
+// only be mapped read-only, by a filter over any item store. Otherwise the
+// item store must be of the same kind and key width, as stores of
+// different kinds can have the same size. The bucket array is the
+// in-memory one, so a mapped filter probes it in place, and as at least 8
+// bytes of checksums follow it the 8-byte bucket reads stay inside the
+// file.
+const uint32_t kFilterMagic = 0x46434646;  // "FFCF"
+// 2: TwoIndependentMultiplyShift mixes the key before multiplying
+// 3: the alternate bucket depends on the low half of the tag only
+// 4: the kind of item store and its key width are recorded
+const uint32_t kFilterFormatVersion = 4;
+
+struct FilterHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t bits_per_item;
+  uint32_t item_size;  // sizeof(ItemType)
+  uint32_t bucket_bytes;
+  uint32_t item_bucket_bytes;
+  uint32_t hasher_size;
+  uint32_t victim_used;
+  uint32_t store_keys;  // 1 if the item store holds keys, 0 for tags
+  uint32_t key_bits;    // the width of the keys it holds
+  uint64_t num_buckets;
+  uint64_t num_items;
+  uint64_t victim_index;
+  uint64_t victim_item;
+  uint64_t victim_tag;
+};
+
+inline void WriteSection(std::ostream &out, const void *data,
+                         const size_t size, uint32_t *checksum) {
+  *checksum = HashUtil::MurmurHash(data, size, *checksum);
+  out.write(static_cast<const char *>(data), size);
+  out.write(reinterpret_cast<const char *>(checksum), sizeof(*checksum));
+}
+
+// false if the stream ends early or the section does not match its checksum
+inline bool ReadSection(std::istream &in, void *data, const size_t size,
+                        uint32_t *checksum) {
+  uint32_t stored;
+  in.read(static_cast<char *>(data), size);
+  in.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+  if (!in) {
+    return false;
+  }
+  *checksum = HashUtil::MurmurHash(data, size, *checksum);
+  return stored == *checksum;
+}
+
+// Map the whole file at path read-only and shared, so that every process
+// mapping it uses the same page cache pages. NULL if it cannot be opened
+// or mapped.
+inline char *MapFile(const char *path, size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // the mapping keeps the file open
+  close(fd);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  *size = st.st_size;
+  return static_cast<char *>(p);
+}
+
+inline void UnmapFile(char *data, const size_t size) { munmap(data, size); }
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_FILTER_FORMAT_H_
@@ -1,6 +1,8 @@
 // Pulled from lookup3.c by Bob Jenkins
 #include "hashutil.h"
 
+#include <string.h>
+
 #define rot(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
 #define mix(a, b, c) \
   {                  \
@@ -661,6 +663,60 @@ uint32_t HashUtil::MurmurHash(const std::string &s, uint32_t seed) {
   return MurmurHash(s.data(), s.length(), seed);
 }
 
+// MurmurHash64A, the 64-bit variant of MurmurHash2 for 64-bit platforms,
+// by Austin Appleby. Same assumptions and limitations as above, except that
+// it reads 8 bytes at a time.
+uint64_t HashUtil::MurmurHash64A(const void *buf, size_t len, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+
+  uint64_t h = seed ^ (len * m);
+
+  const unsigned char *data = (const unsigned char *)buf;
+  const unsigned char *end = data + (len & ~(size_t)7);
+
+  while (data != end) {
+    uint64_t k;
+    memcpy(&k, data, sizeof(k));
+
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+
+    data += 8;
+  }
+
+  switch (len & 7) {
+    case 7:
+      h ^= uint64_t(data[6]) << 48;
+    case 6:
+      h ^= uint64_t(data[5]) << 40;
+    case 5:
+      h ^= uint64_t(data[4]) << 32;
+    case 4:
+      h ^= uint64_t(data[3]) << 24;
+    case 3:
+      h ^= uint64_t(data[2]) << 16;
+    case 2:
+      h ^= uint64_t(data[1]) << 8;
+    case 1:
+      h ^= uint64_t(data[0]);
+      h *= m;
+  };
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+uint64_t HashUtil::MurmurHash64A(const std::string &s, uint64_t seed) {
+  return MurmurHash64A(s.data(), s.length(), seed);
+}
+
 // SuperFastHash aka Hsieh Hash, License: GPL 2.0
 uint32_t HashUtil::SuperFastHash(const void *buf, size_t len) {
   const char *data = (const char *)buf;
@@ -715,6 +771,173 @@ uint32_t HashUtil::SuperFastHash(const std::string &s) {
   return SuperFastHash(s.data(), s.length());
 }
 
+// wyhash final version 4, by Wang Yi, released to the public domain
+namespace {
+
+const uint64_t kWyP[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+                          0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+inline void WyMum(uint64_t *a, uint64_t *b) {
+  const unsigned __int128 r = (unsigned __int128)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+}
+
+inline uint64_t WyRead8(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t WyRead4(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t WyRead3(const unsigned char *p, const size_t k) {
+  return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+}  // namespace
+
+uint64_t HashUtil::WyHash(const void *buf, size_t len, uint64_t seed) {
+  const unsigned char *p = (const unsigned char *)buf;
+  uint64_t a, b;
+
+  seed ^= WyMix(seed ^ kWyP[0], kWyP[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (WyRead4(p) << 32) | WyRead4(p + ((len >> 3) << 2));
+      b = (WyRead4(p + len - 4) << 32) |
+          WyRead4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = WyRead3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = WyMix(WyRead8(p) ^ kWyP[1], WyRead8(p + 8) ^ seed);
+        see1 = WyMix(WyRead8(p + 16) ^ kWyP[2], WyRead8(p + 24) ^ see1);
+        see2 = WyMix(WyRead8(p + 32) ^ kWyP[3], WyRead8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = WyMix(WyRead8(p) ^ kWyP[1], WyRead8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = WyRead8(p + i - 16);
+    b = WyRead8(p + i - 8);
+  }
+  a ^= kWyP[1];
+  b ^= seed;
+  WyMum(&a, &b);
+  return WyMix(a ^ kWyP[0] ^ len, b ^ kWyP[1]);
+}
+
+uint64_t HashUtil::WyHash(const std::string &s, uint64_t seed) {
+  return WyHash(s.data(), s.length(), seed);
+}
+
+// CRC32C (Castagnoli). Both lanes start from half of the seed xor the
+// length; a short last word is zero-padded.
+namespace {
+
+struct Crc32cTable {
+  uint32_t t[256];
+
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int k = 0; k < 8; k++) {
+        crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+      }
+      t[i] = crc;
+    }
+  }
+};
+
+const Crc32cTable kCrc32cTable;
+
+inline uint32_t Crc32cWord(uint32_t crc, uint64_t w) {
+  for (int k = 0; k < 8; k++) {
+    crc = kCrc32cTable.t[(crc ^ w) & 0xff] ^ (crc >> 8);
+    w >>= 8;
+  }
+  return crc;
+}
+
+uint64_t Crc32cHashTable(const unsigned char *p, const size_t len,
+                         const uint64_t seed) {
+  uint32_t lo = (uint32_t)seed ^ (uint32_t)len;
+  uint32_t hi = (uint32_t)(seed >> 32) ^ (uint32_t)len;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    const uint64_t w = WyRead8(p + i);
+    lo = Crc32cWord(lo, w);
+    hi = Crc32cWord(hi, w * HashUtil::kCrc32cLaneMultiplier);
+  }
+  if (i < len) {
+    uint64_t w = 0;
+    memcpy(&w, p + i, len - i);
+    lo = Crc32cWord(lo, w);
+    hi = Crc32cWord(hi, w * HashUtil::kCrc32cLaneMultiplier);
+  }
+  return ((uint64_t)hi << 32) | lo;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint64_t Crc32cHashSse42(
+    const unsigned char *p, const size_t len, const uint64_t seed) {
+  uint32_t lo = (uint32_t)seed ^ (uint32_t)len;
+  uint32_t hi = (uint32_t)(seed >> 32) ^ (uint32_t)len;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    const uint64_t w = WyRead8(p + i);
+    lo = __builtin_ia32_crc32di(lo, w);
+    hi = __builtin_ia32_crc32di(hi, w * HashUtil::kCrc32cLaneMultiplier);
+  }
+  if (i < len) {
+    uint64_t w = 0;
+    memcpy(&w, p + i, len - i);
+    lo = __builtin_ia32_crc32di(lo, w);
+    hi = __builtin_ia32_crc32di(hi, w * HashUtil::kCrc32cLaneMultiplier);
+  }
+  return ((uint64_t)hi << 32) | lo;
+}
+
+bool HasSse42() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+const bool kHasSse42 = HasSse42();
+#endif
+
+}  // namespace
+
+uint64_t HashUtil::Crc32cHash(const void *buf, size_t len, uint64_t seed) {
+#if defined(__x86_64__)
+  if (kHasSse42) {
+    return Crc32cHashSse42((const unsigned char *)buf, len, seed);
+  }
+#endif
+  return Crc32cHashTable((const unsigned char *)buf, len, seed);
+}
+
+uint64_t HashUtil::Crc32cHash(const std::string &s, uint64_t seed) {
+  return Crc32cHash(s.data(), s.length(), seed);
+}
+
 uint32_t HashUtil::NullHash(const void *buf, size_t length,
                             uint32_t shiftbytes) {
   // Ensure that enough bits exist in buffer
@@ -752,6 +975,11 @@ void EVP_MD_CTX_free(EVP_MD_CTX *ctx) {
 }
 #endif
 
+uint64_t HashUtil::RandomSeed() {
+  std::random_device random;
+  return (static_cast<uint64_t>(random()) << 32) | random();
+}
+
 std::string HashUtil::MD5Hash(const char *inbuf, size_t in_length) {
   EVP_MD_CTX *mdctx;
   unsigned char md_value[EVP_MAX_MD_SIZE];
@@ -3,10 +3,17 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
 #include <openssl/evp.h>
 #include <iostream>
 #include <random>
@@ -32,13 +39,50 @@ class HashUtil {
   static uint32_t MurmurHash(const void *buf, size_t length, uint32_t seed = 0);
   static uint32_t MurmurHash(const std::string &s, uint32_t seed = 0);
 
+  // MurmurHash64A, 64-bit MurmurHash2
+  static uint64_t MurmurHash64A(const void *buf, size_t length,
+                                uint64_t seed = 0);
+  static uint64_t MurmurHash64A(const std::string &s, uint64_t seed = 0);
+
   // SuperFastHash
   static uint32_t SuperFastHash(const void *buf, size_t len);
   static uint32_t SuperFastHash(const std::string &s);
 
+  // wyhash (final version 4), by Wang Yi
+  static uint64_t WyHash(const void *buf, size_t length, uint64_t seed = 0);
+  static uint64_t WyHash(const std::string &s, uint64_t seed = 0);
+
+  // 64 bits from two CRC32C lanes over the 8-byte words of the buffer, the
+  // second over the words times an odd constant. Uses the SSE4.2 crc32
+  // instruction where the CPU has it, a table otherwise.
+  static uint64_t Crc32cHash(const void *buf, size_t length,
+                             uint64_t seed = 0);
+  static uint64_t Crc32cHash(const std::string &s, uint64_t seed = 0);
+
   // Null hash (shift and mask)
   static uint32_t NullHash(const void *buf, size_t length, uint32_t shiftbytes);
 
+  // 64 bits from std::random_device, to seed a HashFamily
+  static uint64_t RandomSeed();
+
+  // the next output of the SplitMix64 generator at *state, to expand a
+  // seed into the parameters of a HashFamily
+  static inline uint64_t SplitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // the 64x64 to 128-bit multiply of wyhash, folded to 64 bits
+  static inline uint64_t WyMix(const uint64_t a, const uint64_t b) {
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+  }
+
+  // the multiplier of the second lane of Crc32cHash()
+  static const uint64_t kCrc32cLaneMultiplier = 0x9e3779b97f4a7c15ULL;
+
   // Wrappers for MD5 and SHA1 hashing using EVP
   static std::string MD5Hash(const char *inbuf, size_t in_length);
   static std::string SHA1Hash(const char *inbuf, size_t in_length);
@@ -47,34 +91,87 @@ class HashUtil {
   HashUtil();
 };
 
+// A key given as a pointer and a length, for keys that are not kept in a
+// std::string.
+struct ByteSpan {
+  const void *data;
+  size_t size;
+
+  ByteSpan(const void *d, const size_t n) : data(d), size(n) {}
+};
+
+// The filters hash, and keep in their item store, a 64-bit digest of each
+// key rather than the key itself: the key for integers, and the HashBytes()
+// of the HashFamily for strings. The digest of a key never changes, so the
+// filters can rehash stored items to relocate or lengthen their
+// fingerprints. Another key type plugs in with an overload of its own.
+template <typename HashFamily>
+inline uint64_t KeyDigest(const uint64_t key, const HashFamily &) {
+  return key;
+}
+
+template <typename HashFamily>
+inline uint64_t KeyDigest(const ByteSpan &key, const HashFamily &hasher) {
+  return hasher.HashBytes(key.data, key.size);
+}
+
+template <typename HashFamily>
+inline uint64_t KeyDigest(const std::string &key, const HashFamily &hasher) {
+  return hasher.HashBytes(key.data(), key.size());
+}
+
+template <typename HashFamily>
+inline uint64_t KeyDigest(const char *key, const HashFamily &hasher) {
+  return hasher.HashBytes(key, strlen(key));
+}
+
+#if __cplusplus >= 201703L
+template <typename HashFamily>
+inline uint64_t KeyDigest(const std::string_view key,
+                          const HashFamily &hasher) {
+  return hasher.HashBytes(key.data(), key.size());
+}
+#endif
+
+// Every HashFamily below draws its parameters from a seed: a random one from
+// std::random_device unless constructed with a seed of its own. Its
+// parameters are all it holds, so a filter that is written out with the
+// object keeps hashing the same way when it is read back. Two filters only
+// agree on their hashes if given the same seed or a copy of one object.
+
 // See Martin Dietzfelbinger, "Universal hashing and k-wise independent random
 // variables via integer arithmetic without primes".
 class TwoIndependentMultiplyShift {
   unsigned __int128 multiply_, add_;
 
  public:
-  TwoIndependentMultiplyShift() {
-    ::std::random_device random;
+  TwoIndependentMultiplyShift() { Seed(HashUtil::RandomSeed()); }
 
-    uint32_t a[2] = {0x731557, 0x86f2b144};
-    uint32_t b[8] = {0x5d6d0109, 0x560d379e, 0x4e1514d0, 0xe81a6532,
-                     0x5b8285e6, 0x9c16b2a4, 0x8b485796, 0xc8740d91};
+  explicit TwoIndependentMultiplyShift(const uint64_t seed) { Seed(seed); }
 
-    int i = -1;
+  void Seed(uint64_t seed) {
     for (auto v : {&multiply_, &add_}) {
-      i++;
-      *v = a[i];
-      for (int j = 0; j <= 3; ++j) {
-        *v = *v << 32;
-        *v |= b[i * 4 + j];
-      }
-      std::cout << std::dec;
+      *v = HashUtil::SplitMix64(&seed);
+      *v = (*v << 64) | HashUtil::SplitMix64(&seed);
     }
   }
 
+  // The key goes through the MurmurHash3 finalizer first, a bijection, so
+  // the hash stays 2-independent. Without it, a run of consecutive keys
+  // lands on a lattice of (index, tag) pairs for a few percent of all
+  // seeds and the filter fills up far below its load factor.
   uint64_t operator()(uint64_t key) const {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
     return (add_ + multiply_ * static_cast<decltype(multiply_)>(key)) >> 64;
   }
+
+  uint64_t HashBytes(const void *buf, size_t length) const {
+    return HashUtil::MurmurHash64A(buf, length, (uint64_t)add_);
+  }
 };
 
 // See Patrascu and Thorup's "The Power of Simple Tabulation Hashing"
@@ -82,11 +179,14 @@ class SimpleTabulation {
   uint64_t tables_[sizeof(uint64_t)][1 << CHAR_BIT];
 
  public:
-  SimpleTabulation() {
-    ::std::random_device random;
+  SimpleTabulation() { Seed(HashUtil::RandomSeed()); }
+
+  explicit SimpleTabulation(const uint64_t seed) { Seed(seed); }
+
+  void Seed(uint64_t seed) {
     for (unsigned i = 0; i < sizeof(uint64_t); ++i) {
       for (int j = 0; j < (1 << CHAR_BIT); ++j) {
-        tables_[i][j] = random() | ((static_cast<uint64_t>(random())) << 32);
+        tables_[i][j] = HashUtil::SplitMix64(&seed);
       }
     }
   }
@@ -98,6 +198,61 @@ class SimpleTabulation {
     }
     return result;
   }
+
+  uint64_t HashBytes(const void *buf, size_t length) const {
+    return HashUtil::MurmurHash64A(buf, length, tables_[0][0]);
+  }
+};
+
+// wyhash's multiply-and-fold mix for integer keys and wyhash for strings,
+// about as fast as TwoIndependentMultiplyShift on integers and several
+// times faster than MurmurHash64A on long strings. The seed keys both, so
+// this is the cheap choice for filters that take keys from untrusted
+// sources.
+class WyHashFamily {
+  uint64_t seed_;
+
+ public:
+  WyHashFamily() : seed_(HashUtil::RandomSeed()) {}
+
+  explicit WyHashFamily(const uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return HashUtil::WyMix(key ^ 0x2d358dccaa6c78a5ULL,
+                           seed_ ^ 0x8bb84b93962eacc9ULL);
+  }
+
+  uint64_t HashBytes(const void *buf, size_t length) const {
+    return HashUtil::WyHash(buf, length, seed_);
+  }
+};
+
+// HashUtil::Crc32cHash for integer keys and strings. Two crc32 instructions
+// per integer when built with SSE4.2 enabled; otherwise every call goes
+// through the CPU check in hashutil.cc. A CRC is linear, so which keys
+// collide does not depend on the seed: not for untrusted keys.
+class Crc32cHashFamily {
+  uint64_t seed_;
+
+ public:
+  Crc32cHashFamily() : seed_(HashUtil::RandomSeed()) {}
+
+  explicit Crc32cHashFamily(const uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+#if defined(__SSE4_2__)
+    const uint32_t lo = _mm_crc32_u64((uint32_t)seed_ ^ 8, key);
+    const uint32_t hi = _mm_crc32_u64((uint32_t)(seed_ >> 32) ^ 8,
+                                      key * HashUtil::kCrc32cLaneMultiplier);
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return HashUtil::Crc32cHash(&key, sizeof(key), seed_);
+#endif
+  }
+
+  uint64_t HashBytes(const void *buf, size_t length) const {
+    return HashUtil::Crc32cHash(buf, length, seed_);
+  }
 };
 }  // namespace cuckoofilter
 
@@ -0,0 +1,343 @@
+#ifndef CUCKOO_FILTER_ITEM_STORE_H_
+#define CUCKOO_FILTER_ITEM_STORE_H_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "singletabledata.h"
+
+namespace cuckoofilter {
+
+// Item stores for SingleTableWithStore. A full bucket keeps only half of
+// the tag of each entry, so re-encoding a bucket on insert, delete, kick
+// or ChangeFingerprint needs the full tags from somewhere: the store keeps
+// one value per slot and the table turns it back into the tag.
+//
+// A store is made with the number of buckets and an Options, which the
+// filter is given and passes on to every table it makes. Load() says which
+// buckets are about to be read, for a store that reads several at once
+// faster than one by one. Data() is the store as SizeInBytes() bytes, for
+// serialization, until ReleaseData(). Failed() says that the store has
+// lost data, e.g. on an I/O error; the filter refuses the calls that need
+// it from then on. kBitsPerBucket is what a bucket costs in memory, for the
+// bits_per_key budget of the filter.
+
+// what a store does without options, Load(), ReleaseData() or Failed()
+class ItemStoreBase {
+ public:
+  struct Options {};
+
+  void Load(const size_t *buckets, const size_t n) const {}
+  void ReleaseData() const {}
+  bool Failed() const { return false; }
+};
+
+// The KeyDigest() of every entry; its tag is recomputed by hashing it.
+// This is what Grow, ContainExact and ExportItems need the keys for.
+// Below 64 bits it takes integer keys that fit, e.g. 32-bit IDs at half
+// the size; the digest of a string key never does.
+template <size_t bits_per_key = 64>
+class KeyStore : public SingleTableData<bits_per_key>, public ItemStoreBase {
+ public:
+  static const bool kHoldsKeys = true;
+  static const size_t kKeyBits = bits_per_key;
+  static const bool kCanGrow = true;
+  static const size_t kBitsPerBucket = ((4 * bits_per_key + 7) >> 3) << 3;
+
+  explicit KeyStore(const size_t num, const Options & = Options())
+      : SingleTableData<bits_per_key>(num) {}
+  KeyStore(const size_t num, char *data, const Options & = Options())
+      : SingleTableData<bits_per_key>(num, data) {}
+};
+
+// The full 2 * bits_per_tag tag of every entry, bit-packed: 24 bits a slot
+// for 12-bit tags where KeyStore takes 64, and re-encoding reads the tag
+// instead of hashing. The keys are gone, so a filter over it cannot grow
+// and has no ContainExact.
+template <size_t bits_per_tag>
+class TagStore : public SingleTableData<2 * bits_per_tag>,
+                 public ItemStoreBase {
+ public:
+  static const bool kHoldsKeys = false;
+  // any key goes, only its tag is kept
+  static const size_t kKeyBits = 64;
+  static const bool kCanGrow = false;
+  static const size_t kBitsPerBucket = ((8 * bits_per_tag + 7) >> 3) << 3;
+
+  explicit TagStore(const size_t num, const Options & = Options())
+      : SingleTableData<2 * bits_per_tag>(num) {}
+  TagStore(const size_t num, char *data, const Options & = Options())
+      : SingleTableData<2 * bits_per_tag>(num, data) {}
+};
+
+// The keys stay with the caller, e.g. in the key-value store they come
+// from, and only the tags are in memory. Source says where they are:
+//
+//   struct Source {
+//     // items[4 * k + j] = the KeyDigest() of the key in slot j of bucket
+//     // buckets[k], 0 if the slot is empty
+//     void Fetch(const size_t *buckets, size_t n, uint64_t *items);
+//     // the key in slot j of bucket is now the one with digest item, or
+//     // none if item is 0
+//     void Store(size_t bucket, size_t slot, uint64_t item);
+//   };
+//
+// The Options of the store are the caller's Source, which must outlive
+// the filter. Fetched buckets are kept until the next Load() that does
+// not fit beside them, so an operation costs at most one Fetch: a delete,
+// kick or ChangeFingerprint re-encodes one bucket, ContainExact loads both
+// of its buckets together, a path search a whole level of its walk, and
+// ExportItems runs of buckets. Every write goes to Store at once.
+// Positions belong to one table, so a filter over it does not grow.
+template <typename Source>
+class CallbackStore : public ItemStoreBase {
+  static const size_t kTagsPerBucket = 4;
+  static const size_t kCachedBuckets = 256;
+
+  typedef std::array<uint64_t, kTagsPerBucket> Items;
+
+  // ContainExact() may read from several threads in concurrent mode
+  mutable std::mutex lock_;
+  Source *source_;
+  mutable std::unordered_map<size_t, Items> cached_;
+  size_t num_buckets_;
+
+  // fetch those of buckets[0..n) that are not cached, lock_ held
+  void LoadLocked(const size_t *buckets, size_t n) const {
+    if (n > kCachedBuckets) {
+      n = kCachedBuckets;
+    }
+    std::vector<size_t> missing;
+    for (size_t k = 0; k < n; k++) {
+      if (cached_.find(buckets[k]) == cached_.end()) {
+        missing.push_back(buckets[k]);
+      }
+    }
+    if (missing.empty()) {
+      return;
+    }
+    if (cached_.size() + missing.size() > kCachedBuckets) {
+      cached_.clear();
+    }
+    std::vector<uint64_t> items(kTagsPerBucket * missing.size());
+    source_->Fetch(missing.data(), missing.size(), items.data());
+    for (size_t k = 0; k < missing.size(); k++) {
+      std::copy(&items[kTagsPerBucket * k], &items[kTagsPerBucket * (k + 1)],
+                cached_[missing[k]].begin());
+    }
+  }
+
+ public:
+  static const bool kHoldsKeys = true;
+  static const size_t kKeyBits = 64;
+  static const bool kCanGrow = false;
+  static const size_t kBitsPerBucket = 0;
+  typedef Source *Options;
+
+  CallbackStore(const size_t num, const Options &source)
+      : source_(source), num_buckets_(num) {}
+  // nothing of it is serialized, so there is no data to map
+  CallbackStore(const size_t num, char *data, const Options &source)
+      : source_(source), num_buckets_(num) {}
+
+  size_t NumBuckets() const { return num_buckets_; }
+  size_t SizeInBytes() const { return 0; }
+  char *Data() { return NULL; }
+  const char *Data() const { return NULL; }
+
+  Source &source() { return *source_; }
+
+  void Load(const size_t *buckets, const size_t n) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    LoadLocked(buckets, n);
+  }
+
+  inline uint64_t ReadTag(const size_t i, const size_t j) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    typename std::unordered_map<size_t, Items>::const_iterator it =
+        cached_.find(i);
+    if (it == cached_.end()) {
+      LoadLocked(&i, 1);
+      it = cached_.find(i);
+    }
+    return it->second[j];
+  }
+
+  inline void WriteTag(const size_t i, const size_t j, const uint64_t t) {
+    std::lock_guard<std::mutex> guard(lock_);
+    source_->Store(i, j, t);
+    typename std::unordered_map<size_t, Items>::iterator it = cached_.find(i);
+    if (it != cached_.end()) {
+      it->second[j] = t;
+    }
+  }
+};
+
+// KeyStore in a file, for keys that do not fit in memory next to the
+// buckets. Contain never reads it and a mutation reads one or two
+// buckets, so it can live on an SSD: the file is read and written with
+// pread/pwrite in blocks of whole buckets of about 4 KB, and the last
+// cache_blocks blocks used stay in memory, direct-mapped, until another
+// block needs their place. The file is made in $TMPDIR (/tmp if unset)
+// and unlinked at once, so it goes away with the store; it holds the
+// buckets as KeyStore lays them out in memory, so a filter over it
+// serializes as one over KeyStore does. An I/O error leaves the store
+// Failed(): a block that cannot be read reads as empty and one that cannot
+// be written is lost.
+template <size_t bits_per_key = 64, size_t cache_blocks = 256>
+class FileStore : public ItemStoreBase {
+  static const size_t kTagsPerBucket = 4;
+  static const size_t kBytesPerBucket =
+      (bits_per_key * kTagsPerBucket + 7) >> 3;
+  static const size_t kBucketsPerBlock = 4096 / kBytesPerBucket;
+  static const size_t kBlockBytes = kBucketsPerBlock * kBytesPerBucket;
+  static const size_t kNoBlock = ~(size_t)0;
+
+  // ContainExact() may read from several threads in concurrent mode
+  mutable std::mutex lock_;
+  int fd_;
+  size_t num_buckets_;
+  size_t file_bytes_;
+  // cache entry c holds block blocks_[c] of the file at c * kBlockBytes
+  // of cache_, to be written back if dirty_[c]
+  mutable size_t blocks_[cache_blocks];
+  mutable bool dirty_[cache_blocks];
+  mutable char *cache_;
+  // the file mapped by Data(), until ReleaseData()
+  mutable char *mapping_;
+  mutable bool failed_;
+
+  void Open() {
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir != NULL ? dir : "/tmp") +
+                       "/ffcf-items-XXXXXX";
+    fd_ = mkstemp(&path[0]);
+    const size_t blocks =
+        (num_buckets_ + kBucketsPerBlock - 1) / kBucketsPerBlock;
+    file_bytes_ = blocks * kBlockBytes;
+    if (fd_ >= 0) {
+      unlink(path.c_str());
+    }
+    failed_ = (fd_ < 0 || ftruncate(fd_, file_bytes_) != 0);
+    cache_ = new char[cache_blocks * kBlockBytes];
+    for (size_t c = 0; c < cache_blocks; c++) {
+      blocks_[c] = kNoBlock;
+      dirty_[c] = false;
+    }
+  }
+
+  // write cache entry c back if needed and drop it
+  void Evict(const size_t c) const {
+    if (dirty_[c]) {
+      if (pwrite(fd_, cache_ + c * kBlockBytes, kBlockBytes,
+                 blocks_[c] * kBlockBytes) != (ssize_t)kBlockBytes) {
+        failed_ = true;
+      }
+      dirty_[c] = false;
+    }
+    blocks_[c] = kNoBlock;
+  }
+
+  // the buckets of the block that bucket i is in, read if not cached
+  SingleTableData<bits_per_key> Block(const size_t i, const bool write) const {
+    const size_t block = i / kBucketsPerBlock;
+    const size_t c = block % cache_blocks;
+    char *data = cache_ + c * kBlockBytes;
+    if (blocks_[c] != block) {
+      Evict(c);
+      if (pread(fd_, data, kBlockBytes, block * kBlockBytes) !=
+          (ssize_t)kBlockBytes) {
+        memset(data, 0, kBlockBytes);
+        failed_ = true;
+      }
+      blocks_[c] = block;
+    }
+    dirty_[c] = dirty_[c] || write;
+    return SingleTableData<bits_per_key>(kBucketsPerBlock, data);
+  }
+
+ public:
+  static const bool kHoldsKeys = true;
+  static const size_t kKeyBits = bits_per_key;
+  static const bool kCanGrow = true;
+  // the cache has a fixed size, the buckets are on disk
+  static const size_t kBitsPerBucket = 0;
+
+  explicit FileStore(const size_t num, const Options & = Options())
+      : num_buckets_(num), mapping_(NULL) {
+    Open();
+  }
+  // a copy of SizeInBytes() bytes at data, e.g. from a mapped file
+  FileStore(const size_t num, char *data, const Options & = Options())
+      : num_buckets_(num), mapping_(NULL) {
+    Open();
+    if (pwrite(fd_, data, SizeInBytes(), 0) != (ssize_t)SizeInBytes()) {
+      failed_ = true;
+    }
+  }
+
+  ~FileStore() {
+    ReleaseData();
+    delete[] cache_;
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  size_t NumBuckets() const { return num_buckets_; }
+  size_t SizeInBytes() const { return kBytesPerBucket * num_buckets_; }
+  bool Failed() const { return failed_; }
+
+  // The file mapped shared, after writing back and dropping the cache:
+  // reads see what the store holds and writes through it are seen by the
+  // store. NULL, and the store Failed(), if it cannot be mapped. Only
+  // between Data() and ReleaseData(), and the store must not be used
+  // meanwhile.
+  char *Data() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t c = 0; c < cache_blocks; c++) {
+      Evict(c);
+    }
+    if (mapping_ == NULL && !failed_) {
+      void *p = mmap(NULL, file_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd_, 0);
+      if (p == MAP_FAILED) {
+        failed_ = true;
+      } else {
+        mapping_ = static_cast<char *>(p);
+      }
+    }
+    return mapping_;
+  }
+
+  void ReleaseData() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (mapping_ != NULL) {
+      munmap(mapping_, file_bytes_);
+      mapping_ = NULL;
+    }
+  }
+
+  inline uint64_t ReadTag(const size_t i, const size_t j) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return Block(i, false).ReadTag(i % kBucketsPerBlock, j);
+  }
+
+  inline void WriteTag(const size_t i, const size_t j, const uint64_t t) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Block(i, true).WriteTag(i % kBucketsPerBlock, j, t);
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_ITEM_STORE_H_
@@ -0,0 +1,291 @@
+#ifndef CUCKOO_FILTER_SCALABLE_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_SCALABLE_CUCKOO_FILTER_H_
+
+#include <math.h>
+
+#include <functional>
+#include <sstream>
+#include <vector>
+
+#include "cuckoofilterchange.h"
+
+namespace cuckoofilter {
+
+// A filter for streams of unknown size: a chain of
+// CuckooFilterChangeFLength generations. Items are added to the newest
+// generation, and once its load factor crosses max_load_factor a new one,
+// growth_factor times larger, is appended. All generations hash with the
+// same HashFamily parameters, so Contain hashes a key once and probes the
+// generations from the newest to the oldest. Each generation has an item
+// store of its own, created with the store options of its number.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTableWithEncode,
+          typename HashFamily = TwoIndependentMultiplyShift>
+class ScalableCuckooFilter {
+  typedef CuckooFilterChangeFLength<ItemType, bits_per_item, TableType,
+                                    HashFamily>
+      Generation;
+
+ public:
+  typedef typename Generation::StoreOptions StoreOptions;
+  // the store options of generation g, counting the ones Compact() makes
+  typedef std::function<StoreOptions(size_t g)> StoreOptionsFor;
+
+ private:
+  // generations_.back() is the newest one
+  std::vector<Generation *> generations_;
+  std::vector<size_t> capacities_;
+
+  size_t initial_capacity_;
+  double growth_factor_;
+  double max_load_factor_;
+
+  HashFamily hasher_;
+
+  StoreOptionsFor store_options_;
+  // generations made so far, the number of the next one
+  size_t num_made_;
+
+  Generation *NewGeneration(const size_t capacity) {
+    return new Generation(capacity, 0, hasher_, store_options_(num_made_++));
+  }
+
+  void AddGeneration(const size_t capacity) {
+    generations_.push_back(NewGeneration(capacity));
+    capacities_.push_back(capacity);
+  }
+
+ public:
+  struct GenerationStats {
+    size_t capacity;
+    size_t num_items;
+    size_t size_in_bytes;
+    double load_factor;
+  };
+
+  // Every generation hashes with a copy of hasher and gets store_options
+  // for its item store.
+  explicit ScalableCuckooFilter(
+      const size_t initial_capacity, const double growth_factor = 2,
+      const double max_load_factor = 0.9,
+      const HashFamily &hasher = HashFamily(),
+      const StoreOptions &store_options = StoreOptions())
+      : initial_capacity_(std::max<size_t>(initial_capacity, 1)),
+        growth_factor_(growth_factor),
+        max_load_factor_(max_load_factor),
+        hasher_(hasher),
+        store_options_([store_options](size_t) { return store_options; }),
+        num_made_(0) {
+    AddGeneration(initial_capacity_);
+  }
+
+  // Generation g gets store_options(g), for stores that cannot be shared
+  // between tables: a CallbackStore keys its items by bucket and slot, so
+  // every generation needs a Source of its own. The Sources must outlive
+  // the filter.
+  ScalableCuckooFilter(const size_t initial_capacity,
+                       const double growth_factor,
+                       const double max_load_factor, const HashFamily &hasher,
+                       const StoreOptionsFor &store_options)
+      : initial_capacity_(std::max<size_t>(initial_capacity, 1)),
+        growth_factor_(growth_factor),
+        max_load_factor_(max_load_factor),
+        hasher_(hasher),
+        store_options_(store_options),
+        num_made_(0) {
+    AddGeneration(initial_capacity_);
+  }
+
+  ~ScalableCuckooFilter() {
+    for (size_t g = 0; g < generations_.size(); g++) {
+      delete generations_[g];
+    }
+  }
+
+  // Add an item to the newest generation, appending one if it is full.
+  Status Add(const ItemType &item);
+
+  // Report if the item is in any generation, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Report if the item is in any generation, confirmed against the stored
+  // items as in CuckooFilterChangeFLength::ContainExact. NotSupported on
+  // a TableType that keeps tags only, as is Compact(), which also needs a
+  // TableType that can grow.
+  Status ContainExact(const ItemType &item) const;
+
+  // Adapt the fingerprints of every generation that reports the item.
+  Status ChangeFingerprint(const ItemType &item);
+
+  // Delete the item from the newest generation that holds it. A generation
+  // that only reports it by a false positive is skipped, where deleting
+  // would drop the fingerprint of another item and keep the item. Without
+  // keys to tell, the newest generation reporting it is taken.
+  Status Delete(const ItemType &item);
+
+  // Offline maintenance: merge all generations into a single one sized for
+  // the items currently stored. Lookups then probe one table again.
+  Status Compact();
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  size_t NumGenerations() const { return generations_.size(); }
+  GenerationStats Stats(const size_t g) const {
+    GenerationStats stats;
+    stats.capacity = capacities_[g];
+    stats.num_items = generations_[g]->Size();
+    stats.size_in_bytes = generations_[g]->SizeInBytes();
+    stats.load_factor = generations_[g]->LoadFactor();
+    return stats;
+  }
+
+  size_t Size() const {
+    size_t size = 0;
+    for (size_t g = 0; g < generations_.size(); g++) {
+      size += generations_[g]->Size();
+    }
+    return size;
+  }
+
+  size_t SizeInBytes() const {
+    size_t bytes = 0;
+    for (size_t g = 0; g < generations_.size(); g++) {
+      bytes += generations_[g]->SizeInBytes();
+    }
+    return bytes;
+  }
+};
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::Add(const ItemType &item) {
+  if (generations_.back()->LoadFactor() >= max_load_factor_) {
+    AddGeneration(ceil(capacities_.back() * growth_factor_));
+  }
+  const Status status = generations_.back()->Add(item);
+  if (status != NotEnoughSpace) {
+    return status;
+  }
+  // the newest generation ran out of kicks before max_load_factor
+  AddGeneration(ceil(capacities_.back() * growth_factor_));
+  return generations_.back()->Add(item);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::Contain(const ItemType &item) const {
+  const uint64_t hash = hasher_(KeyDigest(item, hasher_));
+  for (size_t g = generations_.size(); g > 0; g--) {
+    if (generations_[g - 1]->ContainHash(hash) == Ok) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::ContainExact(const ItemType &item)
+    const {
+  if (!generations_.back()->HasKeys()) {
+    return NotSupported;
+  }
+  const uint64_t digest = KeyDigest(item, hasher_);
+  const uint64_t hash = hasher_(digest);
+  for (size_t g = generations_.size(); g > 0; g--) {
+    if (generations_[g - 1]->ContainExactHash(digest, hash) == Ok) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status
+ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                     HashFamily>::ChangeFingerprint(const ItemType &item) {
+  const uint64_t hash = hasher_(KeyDigest(item, hasher_));
+  Status status = NotFound;
+  for (size_t g = generations_.size(); g > 0; g--) {
+    if (generations_[g - 1]->ContainHash(hash) == Ok &&
+        generations_[g - 1]->ChangeFingerprintHash(hash) == Ok) {
+      status = Ok;
+    }
+  }
+  return status;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::Delete(const ItemType &item) {
+  const uint64_t digest = KeyDigest(item, hasher_);
+  const uint64_t hash = hasher_(digest);
+  for (size_t g = generations_.size(); g > 0; g--) {
+    const Status found = generations_[g - 1]->ContainExactHash(digest, hash);
+    if (found == Ok || (found == NotSupported &&
+                        generations_[g - 1]->ContainHash(hash) == Ok)) {
+      return generations_[g - 1]->DeleteExactHash(digest, hash);
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::Compact() {
+  if (!generations_.back()->CanGrow()) {
+    return NotSupported;
+  }
+  std::vector<uint64_t> items;
+  for (size_t g = 0; g < generations_.size(); g++) {
+    generations_[g]->ExportItems(&items);
+  }
+
+  // leave room so that the merged generation starts below max_load_factor
+  const size_t capacity = std::max<size_t>(
+      initial_capacity_,
+      ceil(items.size() * kTargetLoadFactor / max_load_factor_));
+  Generation *merged = NewGeneration(capacity);
+  for (size_t k = 0; k < items.size(); k++) {
+    if (merged->AddHash(items[k], hasher_(items[k])) != Ok) {
+      delete merged;
+      return NotEnoughSpace;
+    }
+  }
+
+  for (size_t g = 0; g < generations_.size(); g++) {
+    delete generations_[g];
+  }
+  generations_.assign(1, merged);
+  capacities_.assign(1, capacity);
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+std::string ScalableCuckooFilter<ItemType, bits_per_item, TableType,
+                                 HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "ScalableCuckooFilter Status:\n"
+     << "\t\tGenerations: " << NumGenerations() << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tTotal size: " << (SizeInBytes() >> 10) << " KB\n";
+  for (size_t g = 0; g < generations_.size(); g++) {
+    GenerationStats stats = Stats(g);
+    ss << "\t\tGeneration " << g << ": capacity " << stats.capacity
+       << ", keys " << stats.num_items << ", load factor "
+       << stats.load_factor << ", " << (stats.size_in_bytes >> 10)
+       << " KB\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_SCALABLE_CUCKOO_FILTER_H_
@@ -0,0 +1,155 @@
+#ifndef CUCKOO_FILTER_SEQ_LOCK_H_
+#define CUCKOO_FILTER_SEQ_LOCK_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace cuckoofilter {
+
+// Sequence counters over stripes of buckets for one writer at a time and
+// any number of readers. The writer makes the counter of a stripe odd
+// while it changes a bucket in it; a reader notes the counters of the
+// stripes it reads, reads without locking and starts over if any of them
+// moved meanwhile. The data read in between is loaded and stored with
+// RelaxedLoad() and RelaxedStore() below, as in Boehm's seqlock: a read
+// that races with a write is then not a data race, and a value it tears
+// is never used, it is read again.
+class StripedSeqLock {
+ public:
+  static const size_t kStripes = 1 << 12;
+  // the counter of state kept outside the buckets, i.e. the victim
+  static const size_t kVictimStripe = kStripes;
+  // a writer preempted in the middle of a write holds its stripes for a
+  // whole time slice, so readers give up the core after this many spins
+  static const size_t kSpinsBeforeYield = 64;
+
+  // serializes the writers
+  std::mutex writer;
+
+  StripedSeqLock() {
+    for (size_t s = 0; s <= kStripes; s++) {
+      seq_[s].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  static size_t Stripe(const size_t bucket) {
+    return bucket & (kStripes - 1);
+  }
+
+  // the counter of stripe s once no write to it is in progress
+  inline uint32_t ReadBegin(const size_t s) const {
+    uint32_t v;
+    for (size_t spins = 0; (v = seq_[s].load(std::memory_order_acquire)) & 1;
+         spins++) {
+      if (spins >= kSpinsBeforeYield) {
+        std::this_thread::yield();
+      }
+    }
+    return v;
+  }
+
+  // true if stripe s has been written since ReadBegin() returned v
+  inline bool ReadRetry(const size_t s, const uint32_t v) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq_[s].load(std::memory_order_relaxed) != v;
+  }
+
+  inline void WriteBegin(const size_t s) {
+    seq_[s].store(seq_[s].load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  inline void WriteEnd(const size_t s) {
+    seq_[s].store(seq_[s].load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint32_t> seq_[kStripes + 1];
+};
+
+// Relaxed atomic access to data that seqlock readers read, in place: the
+// buckets are packed bytes, so this takes plain pointers where C++20 has
+// std::atomic_ref. A relaxed load or store is a plain mov on x86. p must
+// be aligned to sizeof(T), see RelaxedLoadUnaligned() for bucket words.
+template <typename T>
+inline T RelaxedLoad(const T *p) {
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+inline void RelaxedStore(T *p, const T v) {
+  __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+// The same for the little-endian T at p, which need not be aligned, as the
+// words of packed buckets of 5 or 10 bytes are not. On x86 a misaligned
+// mov still is one access, though it may tear where it spans two cache
+// lines, which a seqlock reader notices and reads again. Other targets
+// may fault or take a lock on a misaligned atomic, so there the bytes are
+// accessed one by one, each atomically.
+template <typename T>
+inline T RelaxedLoadUnaligned(const void *p) {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= 8,
+                "an unsigned word of up to 8 bytes");
+#if defined(__x86_64__) || defined(__i386__)
+  return RelaxedLoad(static_cast<const T *>(p));
+#else
+  const uint8_t *b = static_cast<const uint8_t *>(p);
+  T v = 0;
+  for (size_t k = 0; k < sizeof(T); k++) {
+    v |= (T)RelaxedLoad(b + k) << (8 * k);
+  }
+  return v;
+#endif
+}
+
+template <typename T>
+inline void RelaxedStoreUnaligned(void *p, const T v) {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= 8,
+                "an unsigned word of up to 8 bytes");
+#if defined(__x86_64__) || defined(__i386__)
+  RelaxedStore(static_cast<T *>(p), v);
+#else
+  uint8_t *b = static_cast<uint8_t *>(p);
+  for (size_t k = 0; k < sizeof(T); k++) {
+    RelaxedStore(b + k, (uint8_t)(v >> (8 * k)));
+  }
+#endif
+}
+
+// Marks stripes s1 and s2 as written while in scope; a no-op without a
+// lock, so that the writers can share their code with the unsynchronized
+// mode.
+class StripeWriteGuard {
+  StripedSeqLock *lock_;
+  size_t s1_;
+  size_t s2_;
+
+ public:
+  StripeWriteGuard(StripedSeqLock *lock, const size_t s1, const size_t s2)
+      : lock_(lock), s1_(s1), s2_(s2) {
+    if (lock_ != NULL) {
+      lock_->WriteBegin(s1_);
+      if (s2_ != s1_) {
+        lock_->WriteBegin(s2_);
+      }
+    }
+  }
+
+  ~StripeWriteGuard() {
+    if (lock_ != NULL) {
+      if (s2_ != s1_) {
+        lock_->WriteEnd(s2_);
+      }
+      lock_->WriteEnd(s1_);
+    }
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_SEQ_LOCK_H_
@@ -0,0 +1,220 @@
+#ifndef CUCKOO_FILTER_SHARDED_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_SHARDED_CUCKOO_FILTER_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+#include "hashutil.h"
+#include "status.h"
+
+namespace cuckoofilter {
+
+// num_shards independent filters behind one front-end. A key is hashed
+// once; the top log2(num_shards) bits of the hash pick its shard and the
+// whole hash is passed down to the shard's *Hash() calls. Each shard has a
+// lock and a table of its own, so threads working on different shards do
+// not contend, and growing or rebuilding a shard (see WithShard) stalls
+// 1/num_shards of the keys only.
+//
+// Filter is CuckooFilter or CuckooFilterChangeFLength (ChangeFingerprint
+// needs the latter). The front-end and all shards hash with copies of one
+// HashFamily object. Filter indexes its buckets with bits 32 and up of the
+// hash, so a shard should stay below 2^(32 - log2 num_shards) buckets to
+// keep those bits apart from the shard bits.
+template <typename Filter, size_t num_shards>
+class ShardedCuckooFilter {
+  static_assert(num_shards > 0 && (num_shards & (num_shards - 1)) == 0,
+                "num_shards must be a power of two");
+
+  typedef typename Filter::Item ItemType;
+  typedef typename Filter::Hasher HashFamily;
+
+  // one cache line each, so that the locks of two shards never share one
+  struct alignas(64) Shard {
+    mutable std::mutex lock;
+    Filter *filter;
+  };
+
+  Shard shards_[num_shards];
+  HashFamily hasher_;
+
+  static size_t ShardBits() {
+    size_t bits = 0;
+    while ((1ULL << bits) < num_shards) {
+      bits++;
+    }
+    return bits;
+  }
+
+  static inline size_t ShardOf(const uint64_t hash) {
+    return num_shards == 1 ? 0 : hash >> (64 - ShardBits());
+  }
+
+ public:
+  typedef ItemType Item;
+
+  // max_num_keys and bits_per_key are split evenly over the shards.
+  explicit ShardedCuckooFilter(const size_t max_num_keys,
+                               const double bits_per_key = 0,
+                               const HashFamily &hasher = HashFamily())
+      : hasher_(hasher) {
+    const size_t per_shard = (max_num_keys + num_shards - 1) / num_shards;
+    for (size_t s = 0; s < num_shards; s++) {
+      shards_[s].filter = new Filter(per_shard, bits_per_key, hasher_);
+    }
+  }
+
+  ~ShardedCuckooFilter() {
+    for (size_t s = 0; s < num_shards; s++) {
+      delete shards_[s].filter;
+    }
+  }
+
+  Status Add(const ItemType &item) {
+    const uint64_t digest = KeyDigest(item, hasher_);
+    const uint64_t hash = hasher_(digest);
+    Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.filter->AddHash(digest, hash);
+  }
+
+  Status Contain(const ItemType &item) const {
+    const uint64_t hash = hasher_(KeyDigest(item, hasher_));
+    const Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.filter->ContainHash(hash);
+  }
+
+  // needs a Filter with ContainExact, i.e. CuckooFilterChangeFLength
+  Status ContainExact(const ItemType &item) const {
+    const uint64_t digest = KeyDigest(item, hasher_);
+    const uint64_t hash = hasher_(digest);
+    const Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.filter->ContainExactHash(digest, hash);
+  }
+
+  // the hash the shards are given, as from Filter::Hash()
+  uint64_t Hash(const ItemType &item) const {
+    return hasher_(KeyDigest(item, hasher_));
+  }
+
+  // Filter::ChangeFingerprintHashBatch() of every shard on its share of
+  // the hashes, taking each shard lock once; hashes is reordered.
+  size_t ChangeFingerprintHashBatch(uint64_t *hashes, const size_t n) {
+    std::sort(hashes, hashes + n, [](const uint64_t a, const uint64_t b) {
+      return ShardOf(a) < ShardOf(b);
+    });
+    size_t changed = 0;
+    for (size_t k = 0, end; k < n; k = end) {
+      const size_t s = ShardOf(hashes[k]);
+      for (end = k + 1; end < n && ShardOf(hashes[end]) == s; end++) {
+      }
+      std::lock_guard<std::mutex> guard(shards_[s].lock);
+      changed += shards_[s].filter->ChangeFingerprintHashBatch(hashes + k,
+                                                               end - k);
+    }
+    return changed;
+  }
+
+  Status ChangeFingerprint(const ItemType &item) {
+    const uint64_t hash = hasher_(KeyDigest(item, hasher_));
+    Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.filter->ChangeFingerprintHash(hash);
+  }
+
+  // Filter::ContainOrAdapt() on the key's shard, is_absent(item) runs
+  // under the shard lock
+  template <typename IsAbsent>
+  Status ContainOrAdapt(const ItemType &item, IsAbsent is_absent) {
+    const uint64_t hash = hasher_(KeyDigest(item, hasher_));
+    Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    typename Filter::ProbeHandle handle;
+    if (shard.filter->ContainProbeHash(hash, &handle) != Ok) {
+      return NotFound;
+    }
+    if (!is_absent(item)) {
+      return Ok;
+    }
+    shard.filter->AdaptAt(handle);
+    return NotFound;
+  }
+
+  Status Delete(const ItemType &item) {
+    const uint64_t digest = KeyDigest(item, hasher_);
+    const uint64_t hash = hasher_(digest);
+    Shard &shard = shards_[ShardOf(hash)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.filter->DeleteExactHash(digest, hash);
+  }
+
+  // Run fn(Filter &) on shard s under its lock, e.g. to Grow() or rebuild
+  // it while the other shards keep serving.
+  template <typename Fn>
+  void WithShard(const size_t s, Fn fn) {
+    std::lock_guard<std::mutex> guard(shards_[s].lock);
+    fn(*shards_[s].filter);
+  }
+
+  size_t NumShards() const { return num_shards; }
+
+  // number of items in the filter
+  size_t Size() const;
+
+  // size of the filters in bytes
+  size_t SizeInBytes() const;
+
+  // totals followed by the items and size of every shard
+  std::string Info() const;
+};
+
+template <typename Filter, size_t num_shards>
+size_t ShardedCuckooFilter<Filter, num_shards>::Size() const {
+  size_t size = 0;
+  for (size_t s = 0; s < num_shards; s++) {
+    std::lock_guard<std::mutex> guard(shards_[s].lock);
+    size += shards_[s].filter->Size();
+  }
+  return size;
+}
+
+template <typename Filter, size_t num_shards>
+size_t ShardedCuckooFilter<Filter, num_shards>::SizeInBytes() const {
+  size_t bytes = 0;
+  for (size_t s = 0; s < num_shards; s++) {
+    std::lock_guard<std::mutex> guard(shards_[s].lock);
+    bytes += shards_[s].filter->SizeInBytes();
+  }
+  return bytes;
+}
+
+template <typename Filter, size_t num_shards>
+std::string ShardedCuckooFilter<Filter, num_shards>::Info() const {
+  std::stringstream ss;
+  std::stringstream shards;
+  size_t size = 0, bytes = 0;
+  for (size_t s = 0; s < num_shards; s++) {
+    std::lock_guard<std::mutex> guard(shards_[s].lock);
+    const Filter &filter = *shards_[s].filter;
+    size += filter.Size();
+    bytes += filter.SizeInBytes();
+    shards << "\t\tShard " << s << ": " << filter.Size() << " keys, "
+           << (filter.SizeInBytes() >> 10) << " KB\n";
+  }
+  ss << "ShardedCuckooFilter Status:\n"
+     << "\t\tShards: " << num_shards << "\n"
+     << "\t\tKeys stored: " << size << "\n"
+     << "\t\tSize in bytes: " << bytes << "\n";
+  if (size > 0) {
+    ss << "\t\tBits per key: " << 8.0 * bytes / size << "\n";
+  }
+  ss << shards.str();
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_SHARDED_CUCKOO_FILTER_H_
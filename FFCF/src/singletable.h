@@ -2,6 +2,7 @@
 #define CUCKOO_FILTER_SINGLE_TABLE_H_
 
 #include <assert.h>
+#include <string.h>
 
 #include <sstream>
 
@@ -21,6 +22,7 @@ class SingleTable {
   static const size_t kBytesPerBucket =
       (bits_per_tag * kTagsPerBucket + 7) >> 3;
   static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+  static const bool kWordBucket = bits_per_tag * kTagsPerBucket <= 64;
   static const size_t kPaddingBuckets =
       ((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
 
@@ -56,62 +58,43 @@ class SingleTable {
     return ss.str();
   }
 
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_[i].bits_);
+  }
+
+  // Up to 16 bits a bucket fits in one 64-bit word with slot j at bit
+  // j * bits_per_tag, so reads and writes are a shift and a mask; wider
+  // tags are whole uint32_t slots. kWordBucket is known at compile time,
+  // only one of the two paths is emitted for each width.
+  inline uint64_t ReadBucketWord(const size_t i) const {
+    uint64_t w;
+    memcpy(&w, buckets_[i].bits_, sizeof(w));
+    return w;
+  }
+
   inline uint32_t ReadTag(const size_t i, const size_t j) const {
-    const char *p = buckets_[i].bits_;
-    uint32_t tag;
     /* following code only works for little-endian */
-    if (bits_per_tag == 2) {
-      tag = *((uint8_t *)p) >> (j * 2);
-    } else if (bits_per_tag == 4) {
-      p += (j >> 1);
-      tag = *((uint8_t *)p) >> ((j & 1) << 2);
-    } else if (bits_per_tag == 8) {
-      p += j;
-      tag = *((uint8_t *)p);
-    } else if (bits_per_tag == 12) {
-      p += j + (j >> 1);
-      tag = *((uint16_t *)p) >> ((j & 1) << 2);
-    } else if (bits_per_tag == 16) {
-      p += (j << 1);
-      tag = *((uint16_t *)p);
-    } else if (bits_per_tag == 32) {
-      tag = ((uint32_t *)p)[j];
+    if (!kWordBucket) {
+      uint32_t tag;
+      memcpy(&tag, buckets_[i].bits_ + j * sizeof(tag), sizeof(tag));
+      return tag & kTagMask;
     }
-    return tag & kTagMask;
+    return (ReadBucketWord(i) >> (j * bits_per_tag)) & kTagMask;
   }
 
   // write tag to pos(i,j)
   inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
-    char *p = buckets_[i].bits_;
     uint32_t tag = t & kTagMask;
     /* following code only works for little-endian */
-    if (bits_per_tag == 2) {
-      *((uint8_t *)p) |= tag << (2 * j);
-    } else if (bits_per_tag == 4) {
-      p += (j >> 1);
-      if ((j & 1) == 0) {
-        *((uint8_t *)p) &= 0xf0;
-        *((uint8_t *)p) |= tag;
-      } else {
-        *((uint8_t *)p) &= 0x0f;
-        *((uint8_t *)p) |= (tag << 4);
-      }
-    } else if (bits_per_tag == 8) {
-      ((uint8_t *)p)[j] = tag;
-    } else if (bits_per_tag == 12) {
-      p += (j + (j >> 1));
-      if ((j & 1) == 0) {
-        ((uint16_t *)p)[0] &= 0xf000;
-        ((uint16_t *)p)[0] |= tag;
-      } else {
-        ((uint16_t *)p)[0] &= 0x000f;
-        ((uint16_t *)p)[0] |= (tag << 4);
-      }
-    } else if (bits_per_tag == 16) {
-      ((uint16_t *)p)[j] = tag;
-    } else if (bits_per_tag == 32) {
-      ((uint32_t *)p)[j] = tag;
+    if (!kWordBucket) {
+      memcpy(buckets_[i].bits_ + j * sizeof(tag), &tag, sizeof(tag));
+      return;
     }
+    const size_t shift = j * bits_per_tag;
+    uint64_t w = ReadBucketWord(i);
+    w = (w & ~((uint64_t)kTagMask << shift)) | ((uint64_t)tag << shift);
+    // store this bucket's bytes only
+    memcpy(buckets_[i].bits_, &w, kBytesPerBucket);
   }
 
   inline bool FindTagInBuckets(const size_t i1, const size_t i2,
@@ -184,6 +167,18 @@ class SingleTable {
     return false;
   }
 
+  inline uint64_t ReadItem(const size_t i, const size_t j) const {
+    return datatable_->ReadTag(i, j);
+  }
+
+  // overwrite the entry in slot j of bucket i, used to shift entries along
+  // a cuckoo path
+  inline void WriteSlot(const size_t i, const size_t j, const uint32_t tag,
+                        const uint64_t item) {
+    WriteTag(i, j, tag);
+    datatable_->WriteTag(i, j, item);
+  }
+
   inline size_t NumTagsInBucket(const size_t i) const {
     size_t num = 0;
     for (size_t j = 0; j < kTagsPerBucket; j++) {
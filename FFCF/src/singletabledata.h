@@ -2,22 +2,30 @@
 #define CUCKOO_FILTER_SINGLE_TABLE_DATA_H_
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <new>
 #include <sstream>
 
 #include "bitsutil.h"
 #include "debug.h"
 #include "printutil.h"
+#include "seqlock.h"
 
 namespace cuckoofilter {
 
-// the most naive table implementation: one huge bit array
+// the most naive table implementation: one huge bit array, with slot j of
+// a bucket at bit j * bits_per_data of it
 template <size_t bits_per_data>
 class SingleTableData {
+  static_assert(bits_per_data > 0 && bits_per_data <= 64,
+                "a slot holds up to 64 bits");
+
   static const size_t kTagsPerBucket = 4;
   static const size_t kBytesPerBucket =
       (bits_per_data * kTagsPerBucket + 7) >> 3;
-  static const uint64_t kTagMask = (1ULL << bits_per_data) - 1;
+  static const uint64_t kTagMask = ~0ULL >> (64 - bits_per_data);
   static const size_t kPaddingBuckets =
       ((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
 
@@ -28,14 +36,30 @@ class SingleTableData {
   // using a pointer adds one more indirection
   Bucket *buckets_;
   size_t num_buckets_;
+  bool owns_buckets_;
 
  public:
-  explicit SingleTableData(const size_t num) : num_buckets_(num) {
-    buckets_ = new Bucket[num_buckets_ + kPaddingBuckets];
-    memset(buckets_, 0, kBytesPerBucket * (num_buckets_ + kPaddingBuckets));
+  explicit SingleTableData(const size_t num)
+      : num_buckets_(num), owns_buckets_(true) {
+    // calloc hands out untouched zero pages for big tables, so a new table
+    // costs nothing until its buckets are written
+    buckets_ = static_cast<Bucket *>(
+        calloc(num_buckets_ + kPaddingBuckets, kBytesPerBucket));
+    if (buckets_ == NULL) throw ::std::bad_alloc();
   }
 
-  ~SingleTableData() { delete[] buckets_; }
+  // a table over SizeInBytes() bytes at data, e.g. in a mapped file, which
+  // it neither copies nor frees
+  SingleTableData(const size_t num, char *data)
+      : buckets_(reinterpret_cast<Bucket *>(data)),
+        num_buckets_(num),
+        owns_buckets_(false) {}
+
+  ~SingleTableData() {
+    if (owns_buckets_) {
+      free(buckets_);
+    }
+  }
 
   size_t NumBuckets() const { return num_buckets_; }
 
@@ -43,6 +67,10 @@ class SingleTableData {
 
   size_t SizeInTags() const { return kTagsPerBucket * num_buckets_; }
 
+  // the SizeInBytes() bytes of the table, for serialization
+  char *Data() { return buckets_[0].bits_; }
+  const char *Data() const { return buckets_[0].bits_; }
+
   std::string Info() const {
     std::stringstream ss;
     ss << "SingleHashtable with data size: " << bits_per_data << " bits \n";
@@ -52,24 +80,71 @@ class SingleTableData {
     return ss.str();
   }
 
+  // the first n (up to 8) bytes at p as a little-endian word, read and
+  // written with relaxed atomics for the readers of a concurrent filter,
+  // see seqlock.h: whole words of 8 or 4 bytes, others byte by byte
+  static inline uint64_t LoadBytes(const char *p, const size_t n) {
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+    if (n == 8) {
+      return RelaxedLoadUnaligned<uint64_t>(b);
+    }
+    if (n == 4) {
+      return RelaxedLoadUnaligned<uint32_t>(b);
+    }
+    uint64_t w = 0;
+    for (size_t k = 0; k < n; k++) {
+      w |= (uint64_t)RelaxedLoad(b + k) << (8 * k);
+    }
+    return w;
+  }
+
+  static inline void StoreBytes(char *p, const uint64_t w, const size_t n) {
+    uint8_t *b = reinterpret_cast<uint8_t *>(p);
+    if (n == 8) {
+      RelaxedStoreUnaligned<uint64_t>(b, w);
+      return;
+    }
+    if (n == 4) {
+      RelaxedStoreUnaligned<uint32_t>(b, (uint32_t)w);
+      return;
+    }
+    for (size_t k = 0; k < n; k++) {
+      RelaxedStore(b + k, (uint8_t)(w >> (8 * k)));
+    }
+  }
+
+  // A slot spans (shift + bits_per_data + 7) / 8 bytes, up to 9, and only
+  // those are read or written, so the last bucket needs no padding; a
+  // mapped item store ends right there.
   inline uint64_t ReadTag(const size_t i, const size_t j) const {
-    const char *p = buckets_[i].bits_;
-    uint64_t tag;
+    const size_t bit = j * bits_per_data;
+    const size_t shift = bit & 7;
+    const size_t bytes = (shift + bits_per_data + 7) >> 3;
+    const char *p = buckets_[i].bits_ + (bit >> 3);
     /* following code only works for little-endian */
-    if (bits_per_data == 64) {
-      tag = ((uint64_t *)p)[j];
+    uint64_t tag = LoadBytes(p, bytes < 8 ? bytes : 8);
+    tag >>= shift;
+    if (bytes > 8) {
+      tag |= (uint64_t)LoadBytes(p + 8, 1) << (64 - shift);
     }
-
     return tag & kTagMask;
   }
 
   // write tag to pos(i,j)
   inline void WriteTag(const size_t i, const size_t j, const uint64_t t) {
-    char *p = buckets_[i].bits_;
-    uint64_t tag = t & kTagMask;
+    const size_t bit = j * bits_per_data;
+    const size_t shift = bit & 7;
+    const size_t bytes = (shift + bits_per_data + 7) >> 3;
+    char *p = buckets_[i].bits_ + (bit >> 3);
+    const uint64_t tag = t & kTagMask;
     /* following code only works for little-endian */
-    if (bits_per_data == 64) {
-      ((uint64_t *)p)[j] = tag;
+    uint64_t w = LoadBytes(p, bytes < 8 ? bytes : 8);
+    w = (w & ~(kTagMask << shift)) | (tag << shift);
+    StoreBytes(p, w, bytes < 8 ? bytes : 8);
+    if (bytes > 8) {
+      const uint8_t high = 0xff << (shift + bits_per_data - 64);
+      StoreBytes(p + 8, (LoadBytes(p + 8, 1) & high) | (tag >> (64 - shift)),
+                 1);
     }
   }
 
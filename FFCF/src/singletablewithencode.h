@@ -2,18 +2,27 @@
 #define CUCKOO_FILTER_SINGLE_TABLE_WITHENCODE_H_
 
 #include <assert.h>
+#include <string.h>
+#include <functional>
+#include <new>
 #include <sstream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 #include "bitsutil.h"
 #include "debug.h"
 #include "hashutil.h"
 #include "printutil.h"
-#include "singletabledata.h"
+#include "itemstore.h"
 
 namespace cuckoofilter {
 
-template <size_t bits_per_tag>
-class SingleTableWithEncode {
-  SingleTableData<64> *datatable_;
+// ItemStore keeps one value per slot from which the full tag of the entry
+// can be had again, see itemstore.h. Filters take the table as
+// SingleTableWithEncode (keys) or SingleTableWithTags (tags only) below.
+template <size_t bits_per_tag, typename ItemStore>
+class SingleTableWithStore {
+  ItemStore *datatable_;
 
   static const size_t kTagsPerBucket = 4;
   static const size_t kBytesPerBucket =
@@ -24,6 +33,22 @@ class SingleTableWithEncode {
   static const size_t kPaddingBuckets =
       ((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
 
+  // Slots whose long (2 * bits_per_tag) or short (bits_per_tag) form is
+  // valid, as a 4-bit slot mask per occupancy stored at nibble a:
+  //   a = 1: long in slot 0          a = 3: short in 0, 1, long in 2
+  //   a = 2: long in slots 0 and 2   a = 4: short in all four slots
+  static const uint32_t kLongSlots = 0x04510;
+  static const uint32_t kShortSlots = 0xf3000;
+
+  // The kind of field in each slot, two bits per
+  // (occupancy a, slot j) at bit 2 * (4 * a + j): 0 none, 1 short, 2 long.
+  static const uint64_t kSlotKinds = 0x5525222200ULL;
+
+  // the four fields of a bucket, without the occupancy byte
+  static const size_t kFieldBytes = (bits_per_tag * kTagsPerBucket + 7) >> 3;
+  static const uint64_t kFieldMask =
+      ~0ULL >> (64 - bits_per_tag * kTagsPerBucket);
+
   struct Bucket {
     char bits_[kBytesPerBucket];
   } __attribute__((__packed__));
@@ -31,7 +56,9 @@ class SingleTableWithEncode {
   // using a pointer adds one more indirection
   Bucket *buckets_;
   size_t num_buckets_;
-  TwoIndependentMultiplyShift hasher_;
+  bool owns_buckets_;
+  // the hash of the filter, to recompute the tags of stored items
+  std::function<uint64_t(uint64_t)> hasher_;
 
   inline size_t IndexHash(uint32_t hv) const { return hv & (num_buckets_ - 1); }
 
@@ -42,21 +69,57 @@ class SingleTableWithEncode {
     return tag;
   }
 
-  inline void GenerateIndexTagHash(const uint64_t &item, uint32_t *index,
-                                   uint32_t *tag) const {
-    const uint64_t hash = hasher_(item);
-    *index = IndexHash(hash >> 32);
-    *tag = TagHash(hash);
+  // what the item store keeps for an entry
+  static inline uint64_t Stored(const uint32_t tag, const uint64_t item) {
+    return ItemStore::kHoldsKeys ? item : tag;
   }
 
  public:
-  explicit SingleTableWithEncode(const size_t num) : num_buckets_(num) {
-    buckets_ = new Bucket[num_buckets_ + kPaddingBuckets];
-    memset(buckets_, 0, kBytesPerBucket * (num_buckets_ + kPaddingBuckets));
-    datatable_ = new SingleTableData<64>(num_buckets_);
+  typedef typename ItemStore::Options StoreOptions;
+
+  explicit SingleTableWithStore(const size_t num,
+                                const StoreOptions &options = StoreOptions())
+      : num_buckets_(num),
+        owns_buckets_(true),
+        hasher_(TwoIndependentMultiplyShift(0)) {
+    // calloc hands out untouched zero pages for big tables, so a new table
+    // costs nothing until its buckets are written
+    buckets_ = static_cast<Bucket *>(
+        calloc(num_buckets_ + kPaddingBuckets, kBytesPerBucket));
+    if (buckets_ == NULL) throw ::std::bad_alloc();
+    try {
+      datatable_ = new ItemStore(num_buckets_, options);
+    } catch (...) {
+      free(buckets_);
+      throw;
+    }
   }
 
-  ~SingleTableWithEncode() { delete[] buckets_; }
+  // A table over a bucket array and item store laid out as BucketData()
+  // and ItemData(), e.g. in a mapped file; neither is copied or freed.
+  // The 8-byte bucket reads go up to 7 bytes past the last bucket, those
+  // must be readable too. items may be NULL for a table that is only
+  // probed, it has no item store then.
+  SingleTableWithStore(const size_t num, char *buckets, char *items,
+                       const StoreOptions &options = StoreOptions())
+      : datatable_(items != NULL ? new ItemStore(num, items, options) : NULL),
+        buckets_(reinterpret_cast<Bucket *>(buckets)),
+        num_buckets_(num),
+        owns_buckets_(false),
+        hasher_(TwoIndependentMultiplyShift(0)) {}
+
+  ~SingleTableWithStore() {
+    if (owns_buckets_) {
+      free(buckets_);
+    }
+    delete datatable_;
+  }
+
+  // Set the hash that the filter maps items to an index and a tag with, by
+  // default TwoIndependentMultiplyShift with seed 0.
+  void SetHasher(const std::function<uint64_t(uint64_t)> &hasher) {
+    hasher_ = hasher;
+  }
 
   size_t NumBuckets() const { return num_buckets_; }
 
@@ -64,6 +127,72 @@ class SingleTableWithEncode {
 
   size_t SizeInTags() const { return kTagsPerBucket * num_buckets_; }
 
+  // the bucket array (SizeInBytes() bytes) and the item store
+  // (ItemSizeInBytes() bytes) as they are in memory, for serialization;
+  // the item store only until ReleaseItemData()
+  char *BucketData() { return buckets_[0].bits_; }
+  const char *BucketData() const { return buckets_[0].bits_; }
+  // NULL and 0 for a table without item store
+  char *ItemData() { return datatable_ != NULL ? datatable_->Data() : NULL; }
+  const char *ItemData() const {
+    return datatable_ != NULL ? datatable_->Data() : NULL;
+  }
+  void ReleaseItemData() const {
+    if (datatable_ != NULL) {
+      datatable_->ReleaseData();
+    }
+  }
+  size_t ItemSizeInBytes() const {
+    return datatable_ != NULL ? datatable_->SizeInBytes() : 0;
+  }
+  bool HasItems() const { return datatable_ != NULL; }
+  // whether the item store has lost data, see itemstore.h
+  bool ItemsFailed() const {
+    return datatable_ != NULL && datatable_->Failed();
+  }
+  // the items of buckets[0..n) are about to be read, see itemstore.h
+  void LoadItems(const size_t *buckets, const size_t n) const {
+    if (datatable_ != NULL) {
+      datatable_->Load(buckets, n);
+    }
+  }
+  // whether the item store holds the keys rather than their tags
+  static bool HoldsKeys() { return ItemStore::kHoldsKeys; }
+  // the width of the keys the item store takes, and whether item fits it
+  static size_t KeyBits() { return ItemStore::kKeyBits; }
+  static bool Fits(const uint64_t item) {
+    return (item & ~(~0ULL >> (64 - ItemStore::kKeyBits))) == 0;
+  }
+  bool HasKeys() const { return HasItems() && HoldsKeys(); }
+  // the bits a bucket costs in memory, its item store included
+  static size_t BitsPerBucket() {
+    return 8 * kBytesPerBucket + ItemStore::kBitsPerBucket;
+  }
+  // whether the items can be moved into a bigger table
+  bool CanGrow() const { return HasKeys() && ItemStore::kCanGrow; }
+
+  // the tag of an entry from what the item store holds for it, as read by
+  // ReadItem()
+  inline uint32_t TagOf(const uint64_t stored) const {
+    return ItemStore::kHoldsKeys ? TagHash(hasher_(stored)) : stored;
+  }
+
+  // The tag of a kicked-out entry, which may be the low half only: then it
+  // is hashed again from its item. The entry slots 0 and 2 of a full
+  // bucket and the alternate bucket need no more than that half.
+  inline uint32_t WholeTag(const uint32_t tag, const uint64_t item) const {
+    return (ItemStore::kHoldsKeys && (tag >> bits_per_tag) == 0)
+               ? TagOf(item)
+               : tag;
+  }
+
+  // whether slot j of bucket i holds item in the item store; any item does
+  // unless exact
+  inline bool HoldsItem(const size_t i, const size_t j, const bool exact,
+                        const uint64_t item) const {
+    return !exact || datatable_->ReadTag(i, j) == item;
+  }
+
   std::string Info() const {
     std::stringstream ss;
     ss << "SingleHashtable with tag size: " << bits_per_tag << " bits \n";
@@ -73,439 +202,313 @@ class SingleTableWithEncode {
     return ss.str();
   }
 
-  inline uint32_t ReadTag(const size_t i, const size_t j) const {
-    const char *p = buckets_[i].bits_;
-    uint32_t tag;
-    const char *q = buckets_[i].bits_;
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_[i].bits_);
+  }
+
+  // the four slots of a bucket sit in its first 64 bits for every width,
+  // and the padding buckets make the 8-byte read safe for the last one.
+  // Buckets are read and written with relaxed atomics for the readers of a
+  // concurrent filter, see seqlock.h.
+  inline uint64_t ReadBucketWord(const size_t i) const {
+    return RelaxedLoadUnaligned<uint64_t>(buckets_[i].bits_);
+  }
 
-    q += (bits_per_tag >> 1);
-    uint8_t a = *((uint8_t *)q);
+  inline uint32_t ReadOccupancy(const size_t i) const {
+    return RelaxedLoad(reinterpret_cast<const uint8_t *>(buckets_[i].bits_) +
+                       (bits_per_tag >> 1)) &
+           7;
+  }
+
+  // below 16 bits the occupancy byte is part of the bucket word w
+  inline uint32_t ReadOccupancy(const size_t i, const uint64_t w) const {
+    return (bits_per_tag < 16) ? (w >> (kTagsPerBucket * bits_per_tag)) & 7
+                               : ReadOccupancy(i);
+  }
+
+  // ReadTag(i, 4) is the occupancy of bucket i. Slot j always starts at bit
+  // j * bits_per_tag of the bucket word; kSlotKinds only says how wide the
+  // field there is.
+  inline uint32_t ReadTag(const size_t i, const size_t j) const {
+    const uint64_t w = ReadBucketWord(i);
+    const uint32_t a = ReadOccupancy(i, w);
     if (j == 4) {
       return a;
     }
-    if (a == 1 || a == 2) {
-      if (j == 1 || j == 3) {
-        return 0;
-      }
+    const uint32_t kind = (kSlotKinds >> (2 * (4 * a + j))) & 3;
+    return (w >> (j * bits_per_tag)) & ((1ULL << (kind * bits_per_tag)) - 1);
+  }
 
-      if (bits_per_tag == 8) {
-        p += j;
-        tag = *((uint16_t *)p);
-      } else if (bits_per_tag == 12) {
-        p += (j + (j >> 1));
-        tag = *((uint32_t *)p);
-      } else if (bits_per_tag == 16) {
-        p += (j << 1);
-        tag = *((uint32_t *)p);
-      }
-      return tag & twokTagMask;
+  // Writing tag t (or 0 to remove) to slot j of a bucket with occupancy a
+  // follows kSteps[t == 0][4 * a + j]: the low 3 bits are the occupancy
+  // after the write, the high bits one of the ops below. Only the field
+  // bytes and the occupancy byte of the bucket are stored back.
+  inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
+    enum {
+      kKeep = 0,      // not a valid write, leave the bucket alone
+      kPutLong = 1,   // long field at j = t
+      kPutShort = 2,  // short field at j = its half of t
+      kPutPair = 3,   // as kPutShort, and make the short at j - 1 nonzero
+      kClearLong = 4, // long field at j = 0
+      kPullLong = 5,  // long field at 2 moves to 0, the rest is cleared
+      kClearAll = 6
+    };
+#define STEP(op, a) (((op) << 3) | (a))
+    static const uint8_t kSteps[2][20] = {
+        {STEP(kPutLong, 1), STEP(kKeep, 0), STEP(kPutLong, 1), STEP(kKeep, 0),
+         STEP(kKeep, 1), STEP(kKeep, 1), STEP(kPutLong, 2), STEP(kKeep, 1),
+         STEP(kKeep, 2), STEP(kPutPair, 3), STEP(kKeep, 2), STEP(kKeep, 2),
+         STEP(kPutShort, 3), STEP(kPutShort, 3), STEP(kKeep, 3),
+         STEP(kPutPair, 4),
+         STEP(kPutShort, 4), STEP(kPutShort, 4), STEP(kPutShort, 4),
+         STEP(kPutShort, 4)},
+        {STEP(kKeep, 0), STEP(kKeep, 0), STEP(kKeep, 0), STEP(kKeep, 0),
+         STEP(kClearLong, 0), STEP(kKeep, 1), STEP(kKeep, 1), STEP(kKeep, 1),
+         STEP(kPullLong, 1), STEP(kKeep, 2), STEP(kClearLong, 1),
+         STEP(kKeep, 2),
+         STEP(kPullLong, 1), STEP(kPullLong, 1), STEP(kClearAll, 0),
+         STEP(kKeep, 3),
+         STEP(kClearAll, 0), STEP(kClearAll, 0), STEP(kClearAll, 0),
+         STEP(kClearAll, 0)}};
+#undef STEP
+    const uint32_t a = ReadOccupancy(i);
+    assert(a <= 4 && j < kTagsPerBucket);
+    const uint8_t step = kSteps[t == 0][4 * a + j];
+    const size_t shift = j * bits_per_tag;
+    uint64_t w = ReadBucketWord(i) & kFieldMask;
+    uint64_t half = (t >> ((j & 1) * bits_per_tag)) & kTagMask;
+    half += (half == 0);
+
+    switch (step >> 3) {
+      case kKeep:
+        return;
+      case kPutLong:
+        w &= ~((uint64_t)twokTagMask << shift);
+        w |= (uint64_t)(t & twokTagMask) << shift;
+        break;
+      case kPutPair:
+        w |= (uint64_t)(((w >> (shift - bits_per_tag)) & kTagMask) == 0)
+             << (shift - bits_per_tag);
+        // fall through
+      case kPutShort:
+        w &= ~((uint64_t)kTagMask << shift);
+        w |= half << shift;
+        break;
+      case kClearLong:
+        w &= ~((uint64_t)twokTagMask << shift);
+        break;
+      case kPullLong:
+        w = (w >> (2 * bits_per_tag)) & twokTagMask;
+        break;
+      case kClearAll:
+        w = 0;
+        break;
     }
-    if (a == 3) {
-      if (j == 3) {
-        return 0;
-      }
-      if (j == 2) {
-        if (bits_per_tag == 8) {
-          p += j;
-          tag = *((uint16_t *)p);
-        } else if (bits_per_tag == 12) {
-          p += (j + (j >> 1));
-          tag = *((uint32_t *)p);
-        } else if (bits_per_tag == 16) {
-          p += (j << 1);
-          tag = *((uint32_t *)p);
-        }
-        return tag & twokTagMask;
-      } else {
-        if (bits_per_tag == 8) {
-          p += j;
-          tag = *((uint8_t *)p);
-        } else if (bits_per_tag == 12) {
-          p += (j + (j >> 1));
-          tag = *((uint16_t *)p) >> ((j & 1) << 2);
-        } else if (bits_per_tag == 16) {
-          p += (j << 1);
-          tag = *((uint16_t *)p);
-        }
-        return tag & kTagMask;
+    // The field bytes, then the occupancy byte. Only bytes of bucket i are
+    // written, which BulkBuild relies on: a bucket of 8 bytes or more takes
+    // them in one word store, a smaller one byte by byte.
+    uint8_t *p = reinterpret_cast<uint8_t *>(buckets_[i].bits_);
+    const size_t occupancy = bits_per_tag >> 1;
+    if (kBytesPerBucket >= 8) {
+      const uint64_t fields = ~0ULL >> (64 - 8 * kFieldBytes);
+      w |= ReadBucketWord(i) & ~fields;
+      if (occupancy < 8) {
+        w &= ~(0xffULL << (8 * occupancy));
+        w |= (uint64_t)(step & 7) << (8 * occupancy);
+      }
+      RelaxedStoreUnaligned<uint64_t>(p, w);
+    } else {
+      for (size_t b = 0; b < kFieldBytes; b++) {
+        RelaxedStore(p + b, (uint8_t)(w >> (8 * b)));
       }
     }
-    if (a == 4) {
-      if (bits_per_tag == 8) {
-        p += j;
-        tag = *((uint8_t *)p);
-      } else if (bits_per_tag == 12) {
-        p += (j + (j >> 1));
-        tag = *((uint16_t *)p) >> ((j & 1) << 2);
-      } else if (bits_per_tag == 16) {
-        p += (j << 1);
-        tag = *((uint16_t *)p);
-      }
-      return tag & kTagMask;
+    if (kBytesPerBucket < 8 || occupancy >= 8) {
+      RelaxedStore(p + occupancy, (uint8_t)(step & 7));
     }
-    return 0;
   }
 
-  inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
-    char *p = buckets_[i].bits_;
-    uint32_t tag = t & twokTagMask;
+  // Slot mask of the entries of bucket i that match tag, without branching
+  // on the occupancy: every slot is compared in both its long and short
+  // form and the occupancy selects which comparisons count.
+  inline uint32_t MatchTagInBucket(const size_t i, const uint32_t tag,
+                                   const uint32_t tagshort,
+                                   const uint32_t tagshorthigh) const {
+    const uint64_t w = ReadBucketWord(i);
+    const uint32_t a = ReadOccupancy(i, w);
+    const uint32_t longhits =
+        ((w & twokTagMask) == tag) |
+        ((((w >> (2 * bits_per_tag)) & twokTagMask) == tag) << 2);
+    const uint32_t shorthits =
+        ((w & kTagMask) == tagshort) |
+        ((((w >> bits_per_tag) & kTagMask) == tagshorthigh) << 1) |
+        ((((w >> (2 * bits_per_tag)) & kTagMask) == tagshort) << 2) |
+        ((((w >> (3 * bits_per_tag)) & kTagMask) == tagshorthigh) << 3);
+    return (longhits & (kLongSlots >> (4 * a))) |
+           (shorthits & (kShortSlots >> (4 * a)));
+  }
+
+  inline bool FindTagInBucketsScalar(const size_t i1, const size_t i2,
+                                     const uint32_t tag) const {
     uint32_t tagshort = tag & kTagMask;
+    tagshort += (tagshort == 0);
     uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+    tagshorthigh += (tagshorthigh == 0);
+    return (MatchTagInBucket(i1, tag, tagshort, tagshorthigh) |
+            MatchTagInBucket(i2, tag, tagshort, tagshorthigh)) != 0;
+  }
 
-    const char *q = buckets_[i].bits_;
-    uint8_t a;
-    q += (bits_per_tag >> 1);
-    a = *((uint8_t *)q);
-    if (t != 0) {
-      tagshort += (tagshort == 0);
-      tagshorthigh += (tagshorthigh == 0);
-      if (a == 0) {
-        if (j == 1 || j == 3) {
-          return;
-        }
-        if (bits_per_tag == 8) {
-          ((uint16_t *)p)[j] = tag;
-        } else if (bits_per_tag == 12) {
-          ((uint32_t *)p)[j] = tag;
-        } else if (bits_per_tag == 16) {
-          ((uint32_t *)p)[j] = tag;
-        }
-        *((uint8_t *)q) = 1;
-        return;
-      }
-      if (a == 1) {
-        if (j != 2) {
-          return;
-        }
-
-        if (bits_per_tag == 8) {
-          p += 2;
-          *((uint16_t *)p) = tag;
-        } else if (bits_per_tag == 12) {
-          p += 3;
-          *((uint32_t *)p) = tag;
-        } else if (bits_per_tag == 16) {
-          p += 4;
-          *((uint32_t *)p) = tag;
-        }
-        *((uint8_t *)q) = 2;
-        return;
-      }
-      if (a == 2) {
-        if (j != 1) {
-          return;
-        }
+#if defined(__AVX2__)
+  // The same comparisons as MatchTagInBucket for both buckets at once: one
+  // vector holds the two long fields of each bucket, two more hold the four
+  // short fields of each.
+  inline bool FindTagInBucketsAVX2(const size_t i1, const size_t i2,
+                                   const uint32_t tag) const {
+    uint32_t tagshort = tag & kTagMask;
+    tagshort += (tagshort == 0);
+    uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+    tagshorthigh += (tagshorthigh == 0);
 
-        if (bits_per_tag == 8) {
-          ((uint8_t *)p)[j] = tagshorthigh;
-          if (*((uint8_t *)p) == 0) {
-            *((uint8_t *)p) = 1;
-          }
-        } else if (bits_per_tag == 12) {
-          if ((*((uint16_t *)p) & kTagMask) == 0) {
-            *((uint8_t *)p) = 1;
-          }
-          p += 1;
-          ((uint16_t *)p)[0] &= 0x000f;
-          ((uint16_t *)p)[0] |= (tagshorthigh << 4);
-
-        } else if (bits_per_tag == 16) {
-          ((uint16_t *)p)[j] = tagshorthigh;
-          if (*((uint16_t *)p) == 0) {
-            *((uint16_t *)p) = 1;
-          }
-        }
-        *((uint8_t *)q) = 3;
-        return;
-      }
-      if (a == 3) {
-        if (j == 3) {
-          if (bits_per_tag == 8) {
-            ((uint8_t *)p)[j] = tagshorthigh;
-            p += 2;
-            if (*((uint8_t *)p) == 0) {
-              *((uint8_t *)p) = 1;
-            }
-          } else if (bits_per_tag == 12) {
-            p += 3;
-            if ((*((uint16_t *)p) & kTagMask) == 0) {
-              *((uint8_t *)p) = 1;
-            }
-            p += 1;
-            ((uint16_t *)p)[0] &= 0x000f;
-            ((uint16_t *)p)[0] |= (tagshorthigh << 4);
-          } else if (bits_per_tag == 16) {
-            ((uint16_t *)p)[j] = tagshorthigh;
-            p += 4;
-            if (*((uint16_t *)p) == 0) {
-              *((uint16_t *)p) = 1;
-            }
-          }
-          *((uint8_t *)q) = 4;
-          return;
-        }
-        if (j == 0) {
-          if (bits_per_tag == 8) {
-            ((uint8_t *)p)[j] = tagshort;
-          } else if (bits_per_tag == 12) {
-            p += (j + (j >> 1));
-            if ((j & 1) == 0) {
-              ((uint16_t *)p)[0] &= 0xf000;
-              ((uint16_t *)p)[0] |= tagshort;
-            } else {
-              ((uint16_t *)p)[0] &= 0x000f;
-              ((uint16_t *)p)[0] |= (tagshort << 4);
-            }
-          } else if (bits_per_tag == 16) {
-            ((uint16_t *)p)[j] = tagshort;
-          }
-          return;
-        }
-        if (j == 1) {
-          if (bits_per_tag == 8) {
-            ((uint8_t *)p)[j] = tagshorthigh;
-          } else if (bits_per_tag == 12) {
-            p += (j + (j >> 1));
-            if ((j & 1) == 0) {
-              ((uint16_t *)p)[0] &= 0xf000;
-              ((uint16_t *)p)[0] |= tagshorthigh;
-            } else {
-              ((uint16_t *)p)[0] &= 0x000f;
-              ((uint16_t *)p)[0] |= (tagshorthigh << 4);
-            }
-          } else if (bits_per_tag == 16) {
-            ((uint16_t *)p)[j] = tagshorthigh;
-          }
-          return;
-        }
-        return;
-      }
-      if (a == 4) {
-        if (j == 0 || j == 2) {
-          if (bits_per_tag == 8) {
-            ((uint8_t *)p)[j] = tagshort;
-          } else if (bits_per_tag == 12) {
-            p += (j + (j >> 1));
-            if ((j & 1) == 0) {
-              ((uint16_t *)p)[0] &= 0xf000;
-              ((uint16_t *)p)[0] |= tagshort;
-            } else {
-              ((uint16_t *)p)[0] &= 0x000f;
-              ((uint16_t *)p)[0] |= (tagshort << 4);
-            }
-          } else if (bits_per_tag == 16) {
-            ((uint16_t *)p)[j] = tagshort;
-          }
-          return;
-        }
-        if (j == 1 || j == 3) {
-          if (bits_per_tag == 8) {
-            ((uint8_t *)p)[j] = tagshorthigh;
-          } else if (bits_per_tag == 12) {
-            p += (j + (j >> 1));
-            if ((j & 1) == 0) {
-              ((uint16_t *)p)[0] &= 0xf000;
-              ((uint16_t *)p)[0] |= tagshorthigh;
-            } else {
-              ((uint16_t *)p)[0] &= 0x000f;
-              ((uint16_t *)p)[0] |= (tagshorthigh << 4);
-            }
-          } else if (bits_per_tag == 16) {
-            ((uint16_t *)p)[j] = tagshorthigh;
-          }
-          return;
-        }
-        return;
-      }
+    const uint64_t w1 = ReadBucketWord(i1);
+    const uint64_t w2 = ReadBucketWord(i2);
+    const __m256i longshift = _mm256_set_epi64x(2 * bits_per_tag, 0,
+                                                2 * bits_per_tag, 0);
+    const __m256i shortshift =
+        _mm256_set_epi64x(3 * bits_per_tag, 2 * bits_per_tag, bits_per_tag, 0);
+    const __m256i shortmask = _mm256_set1_epi64x(kTagMask);
+    const __m256i shorttags =
+        _mm256_set_epi64x(tagshorthigh, tagshort, tagshorthigh, tagshort);
+
+    const __m256i longs = _mm256_and_si256(
+        _mm256_srlv_epi64(_mm256_set_epi64x(w2, w2, w1, w1), longshift),
+        _mm256_set1_epi64x(twokTagMask));
+    const __m256i shorts1 = _mm256_and_si256(
+        _mm256_srlv_epi64(_mm256_set1_epi64x(w1), shortshift), shortmask);
+    const __m256i shorts2 = _mm256_and_si256(
+        _mm256_srlv_epi64(_mm256_set1_epi64x(w2), shortshift), shortmask);
+
+    // bits 0, 1 are slots 0, 2 of bucket i1 and bits 2, 3 those of i2
+    const uint32_t longhits = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(longs, _mm256_set1_epi64x(tag))));
+    const uint32_t shorthits1 = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(shorts1, shorttags)));
+    const uint32_t shorthits2 = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(shorts2, shorttags)));
+
+    const uint32_t a1 = (bits_per_tag < 16) ? (w1 >> (4 * bits_per_tag)) & 7
+                                            : ReadOccupancy(i1);
+    const uint32_t a2 = (bits_per_tag < 16) ? (w2 >> (4 * bits_per_tag)) & 7
+                                            : ReadOccupancy(i2);
+    const uint32_t longhits1 = (longhits & 1) | ((longhits & 2) << 1);
+    const uint32_t longhits2 = ((longhits >> 2) & 1) | ((longhits >> 1) & 4);
+    return ((longhits1 & (kLongSlots >> (4 * a1))) |
+            (shorthits1 & (kShortSlots >> (4 * a1))) |
+            (longhits2 & (kLongSlots >> (4 * a2))) |
+            (shorthits2 & (kShortSlots >> (4 * a2)))) != 0;
+  }
+#endif
+
+  // Whether bucket i holds tag, with a branch on the occupancy that picks
+  // the fields to compare, as FindTagInBucket() did before kSlotKinds.
+  inline bool MatchTagByOccupancy(const size_t i, const uint32_t tag,
+                                  const uint32_t tagshort,
+                                  const uint32_t tagshorthigh) const {
+    const uint64_t w = ReadBucketWord(i);
+    const uint64_t slot2 = w >> (2 * bits_per_tag);
+    switch (ReadOccupancy(i, w)) {
+      case 1:
+        return (w & twokTagMask) == tag;
+      case 2:
+        return (w & twokTagMask) == tag || (slot2 & twokTagMask) == tag;
+      case 3:
+        return (w & kTagMask) == tagshort ||
+               ((w >> bits_per_tag) & kTagMask) == tagshorthigh ||
+               (slot2 & twokTagMask) == tag;
+      case 4:
+        return (w & kTagMask) == tagshort ||
+               ((w >> bits_per_tag) & kTagMask) == tagshorthigh ||
+               (slot2 & kTagMask) == tagshort ||
+               ((slot2 >> bits_per_tag) & kTagMask) == tagshorthigh;
     }
+    return false;
+  }
 
-    if (t == 0) {
-      if (a == 0) {
-        return;
-      }
-      if (a == 1) {
-        if (j != 0) {
-          return;
-        }
-        if (bits_per_tag == 8) {
-          *((uint16_t *)p) = tag;
-        } else if (bits_per_tag == 12) {
-          *((uint32_t *)p) = tag;
-        } else if (bits_per_tag == 16) {
-          *((uint32_t *)p) = tag;
-        }
-        *((uint8_t *)q) = 0;
-        return;
-      }
-      if (a == 2) {
-        if (j == 1 || j == 3) {
-          return;
-        }
-        if (j == 2) {
-          if (bits_per_tag == 8) {
-            p += 2;
-            *((uint16_t *)p) = 0;
-          } else if (bits_per_tag == 12) {
-            p += 3;
-            *((uint16_t *)p) = 0;
-            p += 2;
-            *((uint8_t *)p) = 0;
-          } else if (bits_per_tag == 16) {
-            p += 4;
-            *((uint32_t *)p) = 0;
-          }
-          *((uint8_t *)q) = 1;
-          return;
-        }
-        if (j == 0) {
-          if (bits_per_tag == 8) {
-            p += 2;
-            tag = *((uint16_t *)p);
-            tag = tag & twokTagMask;
-
-            *((uint16_t *)p) = 0;
-            p -= 2;
-            *((uint16_t *)p) = tag;
-          } else if (bits_per_tag == 12) {
-            p += 3;
-            tag = *((uint32_t *)p);
-            tag = tag & twokTagMask;
-            p -= 3;
-            *((uint32_t *)p) = tag;
-
-            p += 3;
-            *((uint16_t *)p) = 0;
-            p += 2;
-            *((uint8_t *)p) = 0;
-          } else if (bits_per_tag == 16) {
-            p += 4;
-            tag = *((uint32_t *)p);
-            tag = tag & twokTagMask;
-
-            *((uint32_t *)p) = 0;
-            p -= 4;
-            *((uint32_t *)p) = tag;
-          }
-          *((uint8_t *)q) = 1;
-          return;
-        }
-      }
-      if (a == 3) {
-        if (j == 0 || j == 1) {
-          if (bits_per_tag == 8) {
-            p += 2;
-            tag = *((uint16_t *)p);
-            tag = tag & twokTagMask;
-            *((uint16_t *)p) = 0;
-            p -= 2;
-            *((uint16_t *)p) = tag;
-
-          } else if (bits_per_tag == 12) {
-            p += 3;
-            tag = *((uint32_t *)p);
-            tag = tag & twokTagMask;
-            *((uint32_t *)p) = 0;
-            p -= 3;
-            *((uint32_t *)p) = tag;
-          } else if (bits_per_tag == 16) {
-            p += 4;
-            tag = *((uint32_t *)p);
-            tag = tag & twokTagMask;
-            *((uint32_t *)p) = 0;
-            p -= 4;
-            *((uint32_t *)p) = tag;
-          }
-          *((uint8_t *)q) = 1;
-          return;
-        }
-        if (j == 2) {
-          if (bits_per_tag == 8) {
-            *((uint32_t *)p) = 0;
-          } else if (bits_per_tag == 12) {
-            *((uint32_t *)p) = 0;
-            p += 3;
-            *((uint32_t *)p) = 0;
-          } else if (bits_per_tag == 16) {
-            *((uint64_t *)p) = 0;
-          }
-          *((uint8_t *)q) = 0;
-          return;
-        }
-        return;
-      }
-      if (a == 4) {
-        if (bits_per_tag == 8) {
-          *((uint32_t *)p) = 0;
-        } else if (bits_per_tag == 12) {
-          *((uint32_t *)p) = 0;
-          p += 3;
-          *((uint32_t *)p) = 0;
-        } else if (bits_per_tag == 16) {
-          *((uint64_t *)p) = 0;
-        }
-        *((uint8_t *)q) = 0;
-        return;
-      }
-    }
-    return;
+  inline bool FindTagInBucketsByOccupancy(const size_t i1, const size_t i2,
+                                          const uint32_t tag) const {
+    uint32_t tagshort = tag & kTagMask;
+    tagshort += (tagshort == 0);
+    uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+    tagshorthigh += (tagshorthigh == 0);
+    return MatchTagByOccupancy(i1, tag, tagshort, tagshorthigh) ||
+           MatchTagByOccupancy(i2, tag, tagshort, tagshorthigh);
   }
 
+  // The branch-free scalar kernel wins while the table is in cache. Out of
+  // cache the branching kernel is faster, since a hit in bucket i1 spares
+  // the load of i2; it is kept for 16-bit tags, whose occupancy is a load
+  // of its own, unless the vector kernel is built in.
   inline bool FindTagInBuckets(const size_t i1, const size_t i2,
                                const uint32_t tag) const {
+    if (bits_per_tag >= 16) {
+#if defined(__AVX2__)
+      return FindTagInBucketsAVX2(i1, i2, tag);
+#else
+      return FindTagInBucketsByOccupancy(i1, i2, tag);
+#endif
+    }
+    return FindTagInBucketsScalar(i1, i2, tag);
+  }
+
+  // Whether bucket i1 or i2 holds item under tag. Only the slots whose tag
+  // matches are looked up in the item store, so a miss never reads it.
+  inline bool FindItemInBuckets(const size_t i1, const size_t i2,
+                                const uint32_t tag,
+                                const uint64_t item) const {
     uint32_t tagshort = tag & kTagMask;
     tagshort += (tagshort == 0);
     uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
     tagshorthigh += (tagshorthigh == 0);
-    int a1 = ReadTag(i1, 4);
-    int a2 = ReadTag(i2, 4);
-
-    if (a1 == 1) {
-      if ((ReadTag(i1, 0) == tag)) {
-        return true;
-      }
-    }
-    if (a1 == 2) {
-      if ((ReadTag(i1, 0) == tag) || (ReadTag(i1, 2) == tag)) {
-        return true;
-      }
+    const size_t buckets[2] = {i1, i2};
+    uint32_t hits[2];
+    for (size_t b = 0; b < 2; b++) {
+      hits[b] = MatchTagInBucket(buckets[b], tag, tagshort, tagshorthigh);
     }
-    if (a1 == 3) {
-      if ((ReadTag(i1, 0) == tagshort) || (ReadTag(i1, 1) == tagshorthigh) ||
-          (ReadTag(i1, 2) == tag)) {
-        return true;
-      }
+    if (hits[0] != 0 && hits[1] != 0) {
+      datatable_->Load(buckets, 2);
     }
-    if (a1 == 4) {
-      if ((ReadTag(i1, 0) == tagshort) || (ReadTag(i1, 1) == tagshorthigh) ||
-          (ReadTag(i1, 2) == tagshort) || (ReadTag(i1, 3) == tagshorthigh)) {
-        return true;
+    for (size_t b = 0; b < 2; b++) {
+      for (; hits[b] != 0; hits[b] &= hits[b] - 1) {
+        if (datatable_->ReadTag(buckets[b], __builtin_ctz(hits[b])) == item) {
+          return true;
+        }
       }
     }
+    return false;
+  }
 
-    if (a2 == 1) {
-      if ((ReadTag(i2, 0) == tag)) {
-        return true;
-      }
-    }
-    if (a2 == 2) {
-      if ((ReadTag(i2, 0) == tag) || (ReadTag(i2, 2) == tag)) {
-        return true;
-      }
-    }
-    if (a2 == 3) {
-      if ((ReadTag(i2, 0) == tagshort) || (ReadTag(i2, 1) == tagshorthigh) ||
-          (ReadTag(i2, 2) == tag)) {
-        return true;
-      }
-    }
-    if (a2 == 4) {
-      if ((ReadTag(i2, 0) == tagshort) || (ReadTag(i2, 1) == tagshorthigh) ||
-          (ReadTag(i2, 2) == tagshort) || (ReadTag(i2, 3) == tagshorthigh)) {
-        return true;
-      }
+  // FindTagInBuckets() that also reports where: *bucket and *slot are set
+  // to the first short field that matches, in the order
+  // FindWrongTagInBuckets() tries them, as that is the one it would swap.
+  // *slot is kTagsPerBucket if only long fields match.
+  inline bool FindTagSlotInBuckets(const size_t i1, const size_t i2,
+                                   const uint32_t tag, size_t *bucket,
+                                   size_t *slot) const {
+    uint32_t tagshort = tag & kTagMask;
+    tagshort += (tagshort == 0);
+    uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+    tagshorthigh += (tagshorthigh == 0);
+    const uint32_t hits1 = MatchTagInBucket(i1, tag, tagshort, tagshorthigh);
+    const uint32_t hits2 = MatchTagInBucket(i2, tag, tagshort, tagshorthigh);
+    if ((hits1 | hits2) == 0) {
+      *slot = kTagsPerBucket;
+      return false;
     }
-
-    return false;
+    const uint32_t short1 = hits1 & (kShortSlots >> (4 * ReadOccupancy(i1)));
+    const uint32_t short2 = hits2 & (kShortSlots >> (4 * ReadOccupancy(i2)));
+    *bucket = (short1 != 0) ? i1 : i2;
+    *slot = (short1 != 0)   ? __builtin_ctz(short1)
+            : (short2 != 0) ? __builtin_ctz(short2)
+                            : kTagsPerBucket;
+    return true;
   }
 
   inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
@@ -530,12 +533,23 @@ class SingleTableWithEncode {
     }
     return false;
   }
-  inline bool FindWrongTagInBuckets(const size_t i1, const size_t i2,
-                                    const uint32_t tag) {
-    uint64_t olditem, olditem2;
+  // Swap the items of the short pair in slots 2p, 2p + 1 of bucket i. Each
+  // item takes the other half of its own tag, so both keep matching their
+  // keys while the key that hit the pair no longer matches it.
+  inline void SwapShortPair(const size_t i, const size_t p) {
     uint32_t taghasmeans;
-    uint32_t indexnomeans;
+    const uint64_t olditem = datatable_->ReadTag(i, 2 * p);
+    const uint64_t olditem2 = datatable_->ReadTag(i, 2 * p + 1);
+    taghasmeans = TagOf(olditem);
+    WriteTag(i, 2 * p + 1, taghasmeans);
+    taghasmeans = TagOf(olditem2);
+    WriteTag(i, 2 * p, taghasmeans);
+    datatable_->WriteTag(i, 2 * p, olditem2);
+    datatable_->WriteTag(i, 2 * p + 1, olditem);
+  }
 
+  inline bool FindWrongTagInBuckets(const size_t i1, const size_t i2,
+                                    const uint32_t tag) {
     uint32_t tagshort = tag & kTagMask;
     tagshort += (tagshort == 0);
     uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
@@ -543,92 +557,65 @@ class SingleTableWithEncode {
     uint32_t tagread1, tagread2;
     tagread1 = ReadTag(i1, 4);
 
-    if (tagread1 == 3) {
+    if (tagread1 == 3 || tagread1 == 4) {
       if ((ReadTag(i1, 0) == tagshort) || (ReadTag(i1, 1) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i1, 0);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 1, taghasmeans);
-        olditem = datatable_->ReadTag(i1, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 0, taghasmeans);
-        datatable_->WriteTag(i1, 0, olditem);
-        datatable_->WriteTag(i1, 1, olditem2);
+        SwapShortPair(i1, 0);
         return true;
       }
     }
     if (tagread1 == 4) {
-      if ((ReadTag(i1, 0) == tagshort) || (ReadTag(i1, 1) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i1, 0);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 1, taghasmeans);
-        olditem = datatable_->ReadTag(i1, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 0, taghasmeans);
-        datatable_->WriteTag(i1, 0, olditem);
-        datatable_->WriteTag(i1, 1, olditem2);
-        return true;
-      }
       if ((ReadTag(i1, 2) == tagshort) || (ReadTag(i1, 3) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i1, 2);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 3, taghasmeans);
-        olditem = datatable_->ReadTag(i1, 3);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i1, 2, taghasmeans);
-        datatable_->WriteTag(i1, 2, olditem);
-        datatable_->WriteTag(i1, 3, olditem2);
+        SwapShortPair(i1, 1);
         return true;
       }
     }
 
     tagread2 = ReadTag(i2, 4);
-    if (tagread2 == 3) {
+    if (tagread2 == 3 || tagread2 == 4) {
       if ((ReadTag(i2, 0) == tagshort) || (ReadTag(i2, 1) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i2, 0);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 1, taghasmeans);
-        olditem = datatable_->ReadTag(i2, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 0, taghasmeans);
-        datatable_->WriteTag(i2, 0, olditem);
-        datatable_->WriteTag(i2, 1, olditem2);
+        SwapShortPair(i2, 0);
         return true;
       }
     }
     if (tagread2 == 4) {
-      if ((ReadTag(i2, 0) == tagshort) || (ReadTag(i2, 1) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i2, 0);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 1, taghasmeans);
-        olditem = datatable_->ReadTag(i2, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 0, taghasmeans);
-        datatable_->WriteTag(i2, 0, olditem);
-        datatable_->WriteTag(i2, 1, olditem2);
-        return true;
-      }
       if ((ReadTag(i2, 2) == tagshort) || (ReadTag(i2, 3) == tagshorthigh)) {
-        olditem = datatable_->ReadTag(i2, 2);
-        olditem2 = olditem;
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 3, taghasmeans);
-        olditem = datatable_->ReadTag(i2, 3);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        WriteTag(i2, 2, taghasmeans);
-        datatable_->WriteTag(i2, 2, olditem);
-        datatable_->WriteTag(i2, 3, olditem2);
+        SwapShortPair(i2, 1);
         return true;
       }
     }
     return false;
   }
 
+  // FindWrongTagInBuckets() on a slot found by FindTagSlotInBuckets(): swap
+  // its pair if slot j of bucket i still holds a short field matching tag.
+  // Only bucket i is read, nothing is hashed but the two swapped items.
+  inline bool AdaptSlot(const size_t i, const size_t j, const uint32_t tag) {
+    uint32_t tagshort = tag & kTagMask;
+    tagshort += (tagshort == 0);
+    uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
+    tagshorthigh += (tagshorthigh == 0);
+    const uint32_t hits = MatchTagInBucket(i, tag, tagshort, tagshorthigh) &
+                          (kShortSlots >> (4 * ReadOccupancy(i)));
+    if (j >= kTagsPerBucket || (hits & (1U << j)) == 0) {
+      return false;
+    }
+    SwapShortPair(i, j >> 1);
+    return true;
+  }
+
   inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    return DeleteEntryFromBucket(i, tag, false, 0);
+  }
+
+  // DeleteTagFromBucket() of the entry whose item store slot holds item, for
+  // a store of keys: another key with the same tag stays
+  inline bool DeleteItemFromBucket(const size_t i, const uint32_t tag,
+                                   const uint64_t item) {
+    return DeleteEntryFromBucket(i, tag, true, item);
+  }
+
+  inline bool DeleteEntryFromBucket(const size_t i, const uint32_t tag,
+                                    const bool exact, const uint64_t item) {
     uint32_t tagshort = tag & kTagMask;
     tagshort += (tagshort == 0);
     uint32_t tagshorthigh = (tag >> bits_per_tag) & kTagMask;
@@ -638,14 +625,13 @@ class SingleTableWithEncode {
     uint32_t a = ReadTag(i, 4);
     uint64_t olditem;
     uint32_t taghasmeans;
-    uint32_t indexnomeans;
     uint32_t j = 10;
     if (a == 0) {
       return false;
     }
     if (a == 1) {
       tagread1 = ReadTag(i, 0);
-      if (tagread1 == tag) {
+      if (tagread1 == tag && HoldsItem(i, 0, exact, item)) {
         assert(FindTagInBucket(i, tag) == true);
         WriteTag(i, 0, 0);
         datatable_->WriteTag(i, 0, 0);
@@ -654,7 +640,7 @@ class SingleTableWithEncode {
     }
     if (a == 2) {
       tagread1 = ReadTag(i, 2);
-      if (tagread1 == tag) {
+      if (tagread1 == tag && HoldsItem(i, 2, exact, item)) {
         assert(FindTagInBucket(i, tag) == true);
         WriteTag(i, 2, 0);
         datatable_->WriteTag(i, 2, 0);
@@ -662,7 +648,7 @@ class SingleTableWithEncode {
       }
 
       tagread1 = ReadTag(i, 0);
-      if (tagread1 == tag) {
+      if (tagread1 == tag && HoldsItem(i, 0, exact, item)) {
         assert(FindTagInBucket(i, tag) == true);
         WriteTag(i, 0, 0);
 
@@ -673,24 +659,18 @@ class SingleTableWithEncode {
       }
     }
     if (a == 3) {
-      if (ReadTag(i, 0) == tagshort) {
+      // a short field is half of a tag, so it may belong to another entry:
+      // a hit is taken only if its item has the whole tag
+      if (ReadTag(i, 0) == tagshort &&
+          TagOf(datatable_->ReadTag(i, 0)) == tag &&
+          HoldsItem(i, 0, exact, item)) {
         j = 0;
       }
-      if (ReadTag(i, 1) == tagshorthigh) {
+      if (ReadTag(i, 1) == tagshorthigh &&
+          TagOf(datatable_->ReadTag(i, 1)) == tag &&
+          HoldsItem(i, 1, exact, item)) {
         j = 1;
       }
-      if (j == 1 && (ReadTag(i, 0) == tagshort)) {
-        olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 0;
-        }
-        olditem = datatable_->ReadTag(i, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 1;
-        }
-      }
 
       if (j == 0) {
         WriteTag(i, 0, 0);
@@ -699,7 +679,7 @@ class SingleTableWithEncode {
         olditem = datatable_->ReadTag(i, 1);
         datatable_->WriteTag(i, 2, olditem);
         datatable_->WriteTag(i, 1, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
 
         WriteTag(i, 2, taghasmeans);
         return true;
@@ -713,70 +693,36 @@ class SingleTableWithEncode {
         datatable_->WriteTag(i, 0, olditem);
         olditem = datatable_->ReadTag(i, 1);
         datatable_->WriteTag(i, 2, olditem);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
 
         WriteTag(i, 2, taghasmeans);
         datatable_->WriteTag(i, 1, 0);
         return true;
       }
       tagread1 = ReadTag(i, 2);
-      if (tagread1 == tag) {
+      if (tagread1 == tag && HoldsItem(i, 2, exact, item)) {
         assert(FindTagInBucket(i, tag) == true);
         WriteTag(i, 2, 0);
         olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 0, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 1);
         datatable_->WriteTag(i, 1, 0);
         datatable_->WriteTag(i, 2, olditem);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 2, taghasmeans);
 
         return true;
       }
     }
     if (a == 4) {
-      uint32_t j0 = 0;
-      uint32_t j1 = 0;
-      uint32_t j2 = 0;
-      uint32_t j3 = 0;
-      if (ReadTag(i, 0) == tagshort) {
-        j = 0;
-        j0 = 1;
-      }
-      if (ReadTag(i, 1) == tagshorthigh) {
-        j = 1;
-        j1 = 1;
-      }
-      if (ReadTag(i, 2) == tagshort) {
-        j = 2;
-        j2 = 1;
-      }
-      if (ReadTag(i, 3) == tagshorthigh) {
-        j = 3;
-        j3 = 1;
-      }
-      if (j0 + j1 + j2 + j3 > 1) {
-        olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 0;
-        }
-        olditem = datatable_->ReadTag(i, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 1;
-        }
-        olditem = datatable_->ReadTag(i, 2);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 2;
-        }
-        olditem = datatable_->ReadTag(i, 3);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
-        if (tag == taghasmeans) {
-          j = 3;
+      // as for a == 3, every field is short here
+      for (uint32_t k = 0; k < kTagsPerBucket; k++) {
+        if (ReadTag(i, k) == ((k % 2 == 0) ? tagshort : tagshorthigh) &&
+            TagOf(datatable_->ReadTag(i, k)) == tag &&
+            HoldsItem(i, k, exact, item)) {
+          j = k;
         }
       }
 
@@ -784,16 +730,16 @@ class SingleTableWithEncode {
         WriteTag(i, 0, 0);
         olditem = datatable_->ReadTag(i, 3);
         datatable_->WriteTag(i, 0, olditem);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 0, taghasmeans);
 
         datatable_->WriteTag(i, 3, 0);
         olditem = datatable_->ReadTag(i, 2);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 2, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 1, taghasmeans);
 
         return true;
@@ -803,15 +749,15 @@ class SingleTableWithEncode {
         WriteTag(i, 0, 0);
 
         olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 0, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 2);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 2, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 3);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 1, taghasmeans);
         datatable_->WriteTag(i, 3, 0);
         datatable_->WriteTag(i, 1, olditem);
@@ -822,17 +768,17 @@ class SingleTableWithEncode {
         WriteTag(i, 0, 0);
 
         olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 0, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 3);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 2, taghasmeans);
         datatable_->WriteTag(i, 3, 0);
         datatable_->WriteTag(i, 2, olditem);
 
         olditem = datatable_->ReadTag(i, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 1, taghasmeans);
 
         return true;
@@ -842,16 +788,16 @@ class SingleTableWithEncode {
         WriteTag(i, 0, 0);
 
         olditem = datatable_->ReadTag(i, 0);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 0, taghasmeans);
 
         olditem = datatable_->ReadTag(i, 2);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 2, taghasmeans);
         datatable_->WriteTag(i, 3, 0);
 
         olditem = datatable_->ReadTag(i, 1);
-        GenerateIndexTagHash(olditem, &indexnomeans, &taghasmeans);
+        taghasmeans = TagOf(olditem);
         WriteTag(i, 1, taghasmeans);
 
         return true;
@@ -861,57 +807,132 @@ class SingleTableWithEncode {
     return false;
   }
 
+  // Put tag into bucket i if it has room. Otherwise, with kickout, it
+  // replaces the entry in a random slot, whose item goes to olditem and
+  // whose tag goes to oldtag. Out of slot 0 or 2 of a table with keys that
+  // is just the low half, read from the bucket instead of hashing the item,
+  // and tag may be such a half too, see WholeTag().
   inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
                                 const bool kickout, uint32_t &oldtag,
                                 const uint64_t item, uint64_t &olditem) {
+    const uint64_t stored = Stored(tag, item);
     uint32_t a = ReadTag(i, 4);
     if (a == 0) {
       WriteTag(i, 0, tag);
-      datatable_->WriteTag(i, 0, item);
+      datatable_->WriteTag(i, 0, stored);
       return true;
     }
     if (a == 1) {
       WriteTag(i, 2, tag);
-      datatable_->WriteTag(i, 2, item);
+      datatable_->WriteTag(i, 2, stored);
       return true;
     }
     if (a == 2) {
       WriteTag(i, 1, tag);
-      datatable_->WriteTag(i, 1, item);
+      datatable_->WriteTag(i, 1, stored);
       return true;
     }
     if (a == 3) {
       WriteTag(i, 3, tag);
-      datatable_->WriteTag(i, 3, item);
+      datatable_->WriteTag(i, 3, stored);
       return true;
     }
 
     if (a == 4 && kickout) {
       size_t r = rand() % kTagsPerBucket;
       olditem = datatable_->ReadTag(i, r);
-      WriteTag(i, r, tag);
-      datatable_->WriteTag(i, r, item);
+      oldtag = (ItemStore::kHoldsKeys && r % 2 == 0) ? ReadTag(i, r)
+                                                     : TagOf(olditem);
+      WriteTag(i, r, (r % 2 == 0) ? tag : WholeTag(tag, item));
+      datatable_->WriteTag(i, r, stored);
     }
     return false;
   }
 
-  inline size_t NumTagsInBucket(const size_t i) const {
-    size_t num = 0;
+  // copy the items stored in bucket i to items[], return how many there are.
+  // slots fill in the order 0, 2, 1, 3 (see InsertTagToBucket), so with
+  // occupancy a the items live in slots {0}, {0,2}, {0,1,2} or {0,1,2,3}.
+  inline size_t ReadItemsFromBucket(const size_t i, uint64_t *items) const {
+    uint32_t a = ReadTag(i, 4);
+    if (a == 2) {
+      items[0] = datatable_->ReadTag(i, 0);
+      items[1] = datatable_->ReadTag(i, 2);
+      return 2;
+    }
+    for (size_t j = 0; j < a; j++) {
+      items[j] = datatable_->ReadTag(i, j);
+    }
+    return a;
+  }
+
+  inline uint64_t ReadItem(const size_t i, const size_t j) const {
+    return datatable_->ReadTag(i, j);
+  }
+
+  // overwrite the entry in slot j of a full bucket i, used to shift entries
+  // along a cuckoo path. Slot j keeps its half of the new tag, so the
+  // encoding of the other slots is not affected.
+  inline void WriteSlot(const size_t i, const size_t j, const uint32_t tag,
+                        const uint64_t item) {
+    assert(ReadOccupancy(i) == kTagsPerBucket);
+    WriteTag(i, j, tag);
+    datatable_->WriteTag(i, j, Stored(tag, item));
+  }
+
+  // empty bucket i, its items having been moved to another table
+  inline void ClearBucket(const size_t i) {
+    memset(buckets_[i].bits_, 0, kBytesPerBucket);
     for (size_t j = 0; j < kTagsPerBucket; j++) {
-      if (ReadTag(i, j) != 0) {
-        num++;
-      }
+      datatable_->WriteTag(i, j, 0);
     }
-    return num;
+  }
+
+  // the occupancy is the number of entries
+  inline size_t NumTagsInBucket(const size_t i) const {
+    return ReadOccupancy(i);
   }
 
   inline size_t BucketInfo(const size_t i) const {
     size_t num = 0;
-    for (size_t j = 0; j < 8192; j++) {
+    for (size_t j = 0; j < num_buckets_; j++) {
       std::cout << ReadTag(j, 4) << std::endl;
     }
     return 0;
   }
 };
+
+// the table with the KeyDigest() of every entry
+template <size_t bits_per_tag>
+using SingleTableWithEncode = SingleTableWithStore<bits_per_tag, KeyStore<> >;
+
+// the table with keys of bits_per_key bits, for integer keys below
+// 2^bits_per_key: CuckooFilterChangeFLength<uint64_t, 12,
+// SingleTableWithKeys<40>::Table>
+template <size_t bits_per_key>
+struct SingleTableWithKeys {
+  template <size_t bits_per_tag>
+  using Table = SingleTableWithStore<bits_per_tag, KeyStore<bits_per_key> >;
+};
+
+// the table with its keys in a file, see FileStore:
+// CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithFile<>::Table>
+template <size_t bits_per_key = 64>
+struct SingleTableWithFile {
+  template <size_t bits_per_tag>
+  using Table = SingleTableWithStore<bits_per_tag, FileStore<bits_per_key> >;
+};
+
+// the table whose keys the caller keeps, see CallbackStore:
+// CuckooFilterChangeFLength<uint64_t, 12, SingleTableWithSource<S>::Table>
+template <typename Source>
+struct SingleTableWithSource {
+  template <size_t bits_per_tag>
+  using Table = SingleTableWithStore<bits_per_tag, CallbackStore<Source> >;
+};
+
+// the table with just the full tag of every entry, see TagStore
+template <size_t bits_per_tag>
+using SingleTableWithTags =
+    SingleTableWithStore<bits_per_tag, TagStore<bits_per_tag> >;
 }  // namespace cuckoofilter
 #endif  // CUCKOO_FILTER_SINGLE_TABLE_H_
@@ -0,0 +1,38 @@
+#ifndef CUCKOO_FILTER_STATUS_H_
+#define CUCKOO_FILTER_STATUS_H_
+
+#include <stddef.h>
+
+namespace cuckoofilter {
+// status returned by a cuckoo filter operation
+enum Status {
+  Ok = 0,
+  NotFound = 1,
+  NotEnoughSpace = 2,
+  NotSupported = 3,
+  InvalidFormat = 4,
+};
+
+// maximum number of cuckoo kicks before claiming failure
+const size_t kMaxCuckooCount = 500;
+
+// how Add() makes room when both buckets of an item are full
+enum InsertMode {
+  // kick random entries out until one lands in a free slot, for at most
+  // kMaxCuckooCount kicks
+  RandomWalk = 0,
+  // search breadth-first for the shortest chain of entries that ends next
+  // to a free slot, then shift the entries along it
+  PathSearch = 1,
+};
+
+// maximum number of full buckets the path search expands
+const size_t kMaxPathSearchBuckets = 256;
+
+// occupancy the table is sized for when built from max_num_keys
+const double kTargetLoadFactor = 0.95;
+
+// number of keys ContainBatch hashes and prefetches ahead of probing
+const size_t kContainBatchWindow = 16;
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_STATUS_H_